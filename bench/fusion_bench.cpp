@@ -0,0 +1,196 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Accuracy benchmark of the sensor fusion. A deterministic head motion is
+// converted into sensor reports with gyro bias, noise and accelerations of
+// the head. The reports are replayed through ImuIntegrator with and without
+// tilt correction and the tilt error against the true motion is measured.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "imu.h"
+#include "sensor_device.h"
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+const uint32_t kSampleIntervalUs = 500;
+const double kDurationMs = 300000.0;
+const double kGyroBias[3] = {0.0004, -0.0002, 0.0003}; //!< Degrees per ms, about 0.3 degree per second
+const double kMaxTiltErrorDegrees = 2.0; //!< Acceptable tilt error with correction at the end of replay
+
+/*! Small deterministic generator, so every run replays the same data */
+class Noise {
+ public:
+  Noise(): state_(12345) {}
+  double Next() {
+    state_ = state_ * 1103515245 + 12345;
+    return ((state_ >> 16) & 0x7fff) / 16384.0 - 1.0;
+  }
+
+ private:
+  uint32_t state_;
+};
+
+ImuQuaternion AxisQuaternion(size_t axis, double degrees) {
+  double half = degrees * kPi / 360.0;
+  ImuQuaternion q = {std::cos(half), 0.0, 0.0, 0.0};
+  double s = std::sin(half);
+  if (axis == 0) {
+    q.x = s;
+  } else if (axis == 1) {
+    q.y = s;
+  } else {
+    q.z = s;
+  }
+  return q;
+}
+
+/*! True orientation: turns, nods and tilts of the watching user */
+ImuQuaternion TrueOrientation(double ms) {
+  double t = ms * 0.001;
+  ImuQuaternion yaw = AxisQuaternion(1, 70.0 * std::sin(2.0 * kPi * t / 11.0));
+  ImuQuaternion pitch = AxisQuaternion(0, 20.0 * std::sin(2.0 * kPi * t / 7.0));
+  ImuQuaternion roll = AxisQuaternion(2, 10.0 * std::sin(2.0 * kPi * t / 5.0));
+  return MultiplyQuaternions(MultiplyQuaternions(yaw, pitch), roll);
+}
+
+ImuQuaternion Inverse(const ImuQuaternion& q) {
+  ImuQuaternion r = {q.w, -q.x, -q.y, -q.z};
+  return r;
+}
+
+int16_t ToRaw(double value) {
+  double v = std::floor(value + 0.5);
+  return static_cast<int16_t>(v > 32767.0 ? 32767.0 : (v < -32768.0 ? -32768.0 : v));
+}
+
+void WriteInt16(unsigned char* buffer, size_t offset, int16_t value) {
+  buffer[offset] = value & 0xff;
+  buffer[offset + 1] = (value >> 8) & 0xff;
+}
+
+void WriteUInt32(unsigned char* buffer, size_t offset, uint32_t value) {
+  for (size_t i = 0; i < 4; ++i) {
+    buffer[offset + i] = (value >> (i * 8)) & 0xff;
+  }
+}
+
+/*! Makes reports of the motion and true orientations of their last samples */
+void MakeReports(std::vector<SensorReport>& reports, std::vector<ImuQuaternion>& truth) {
+  Noise noise;
+  const double level[3] = {0.0, -1.0, 0.0};
+  uint32_t tick = 0;
+  double ms = 0.0;
+  ImuQuaternion prev = TrueOrientation(0.0);
+  while (ms < kDurationMs) {
+    SensorReport r = {};
+    r.size = kSensorReportSize;
+    ImuQuaternion current = prev;
+    for (size_t s = 0; s < kImuSamplesPerReport; ++s) {
+      ms += kSampleIntervalUs * 0.001;
+      tick += kSampleIntervalUs;
+      current = TrueOrientation(ms);
+
+      // Angle speed in the helmet frame
+      double speed[3];
+      GetRotationAngles(MultiplyQuaternions(Inverse(prev), current), speed);
+      prev = current;
+
+      // Gravity in the helmet frame with accelerations of the head
+      double gravity[3];
+      RotateVector(Inverse(current), level, gravity);
+
+      size_t offset = 16 + s * 16;
+      WriteUInt32(r.data, offset, tick);
+      double k = 1.0 / (kSampleIntervalUs * 0.001) / kGyroCoef;
+      WriteInt16(r.data, offset + 4, ToRaw(-(speed[1] + kGyroBias[1]) * k + noise.Next() * 2.0));
+      WriteInt16(r.data, offset + 6, ToRaw(-(speed[0] + kGyroBias[0]) * k + noise.Next() * 2.0));
+      WriteInt16(r.data, offset + 8, ToRaw(-(speed[2] + kGyroBias[2]) * k + noise.Next() * 2.0));
+      WriteInt16(r.data, offset + 10, ToRaw(-(gravity[1] + noise.Next() * 0.03) * kAccelOneG));
+      WriteInt16(r.data, offset + 12, ToRaw(-(gravity[0] + noise.Next() * 0.03) * kAccelOneG));
+      WriteInt16(r.data, offset + 14, ToRaw(-(gravity[2] + noise.Next() * 0.03) * kAccelOneG));
+    }
+    reports.push_back(r);
+    truth.push_back(current);
+  }
+}
+
+/*! Angle between gravity directions of two orientations, degrees */
+double TiltError(const ImuQuaternion& estimated, const ImuQuaternion& truth) {
+  const double level[3] = {0.0, -1.0, 0.0};
+  double e[3], t[3];
+  RotateVector(Inverse(estimated), level, e);
+  RotateVector(Inverse(truth), level, t);
+  double c = e[0] * t[0] + e[1] * t[1] + e[2] * t[2];
+  return std::acos(c > 1.0 ? 1.0 : c) * 180.0 / kPi;
+}
+
+double Replay(const std::vector<SensorReport>& reports, const std::vector<ImuQuaternion>& truth,
+    bool correction, double& ns_per_report) {
+  ImuIntegrator integrator;
+  integrator.SetTiltCorrection(correction);
+  ImuQuaternion orientation = kIdentityQuaternion;
+  const double velo[3] = {0.0, 0.0, 0.0};
+  ImuSample samples[kImuSamplesPerReport];
+  std::vector<double> errors(reports.size());
+
+  // The first sample only starts integration: its orientation is the truth
+  auto start = std::chrono::steady_clock::now();
+  for (size_t r = 0; r < reports.size(); ++r) {
+    size_t count = ParseSensorReport(reports[r].data, reports[r].size, samples);
+    for (size_t i = 0; i < count; ++i) {
+      if (r == 0 && i == 0) {
+        orientation = TrueOrientation(kSampleIntervalUs * 0.001);
+      }
+      integrator.Integrate(samples[i], velo, orientation);
+    }
+    errors[r] = TiltError(orientation, truth[r]);
+  }
+  auto dur = std::chrono::steady_clock::now() - start;
+  ns_per_report = std::chrono::duration_cast<std::chrono::nanoseconds>(dur).count() /
+      static_cast<double>(reports.size());
+
+  // Error of the last minute
+  double max_error = 0.0;
+  for (size_t r = reports.size() * 4 / 5; r < reports.size(); ++r) {
+    max_error = std::max(max_error, errors[r]);
+  }
+  return max_error;
+}
+
+} // namespace
+
+int main() {
+  std::vector<SensorReport> reports;
+  std::vector<ImuQuaternion> truth;
+  MakeReports(reports, truth);
+
+  double gyro_ns, fusion_ns;
+  double gyro_error = Replay(reports, truth, false, gyro_ns);
+  double fusion_error = Replay(reports, truth, true, fusion_ns);
+  printf("Replayed %zu reports (%.0f s of motion with gyro bias)\n",
+      reports.size(), kDurationMs * 0.001);
+  printf("Gyro only:        max tilt error %6.2f degrees, %6.1f ns per report\n", gyro_error, gyro_ns);
+  printf("Tilt correction:  max tilt error %6.2f degrees, %6.1f ns per report\n", fusion_error, fusion_ns);
+  return fusion_error < kMaxTiltErrorDegrees ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Benchmark of sensor report parsing and per-sample integration as it's done
+// by the reader thread of PsvrSensors. The helmet sends a report about every
+// millisecond, so processing of one report must stay far below it.
+// Usage: imu_bench [session file]. Without the file synthetic reports are used.
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "imu.h"
+#include "sensor_device.h"
+#include "session_record.h"
+
+namespace {
+
+const size_t kReportCount = 4096;
+const int kIterations = 500;
+const uint32_t kSampleIntervalUs = 500;
+const double kReportBudgetNs = 1000000.0;
+
+void WriteInt16(unsigned char* buffer, size_t offset, int16_t value) {
+  buffer[offset] = value & 0xff;
+  buffer[offset + 1] = (value >> 8) & 0xff;
+}
+
+void WriteUInt32(unsigned char* buffer, size_t offset, uint32_t value) {
+  for (size_t i = 0; i < 4; ++i) {
+    buffer[offset + i] = (value >> (i * 8)) & 0xff;
+  }
+}
+
+/*! Makes reports of slow head turn. Ticks start near overflow to check wrap around */
+void MakeReports(std::vector<SensorReport>& reports) {
+  reports.resize(kReportCount);
+  uint32_t tick = 0xffffffff - kSampleIntervalUs * 100;
+  for (size_t i = 0; i < reports.size(); ++i) {
+    SensorReport& r = reports[i];
+    r.size = kSensorReportSize;
+    for (size_t s = 0; s < kImuSamplesPerReport; ++s) {
+      size_t offset = 16 + s * 16;
+      WriteUInt32(r.data, offset, tick);
+      WriteInt16(r.data, offset + 4, 1600); // 0.1 degree per ms
+      WriteInt16(r.data, offset + 6, static_cast<int16_t>(i % 64) - 32);
+      WriteInt16(r.data, offset + 8, -16);
+      WriteInt16(r.data, offset + 10, static_cast<int16_t>(kAccelOneG)); // Level helmet
+      tick += kSampleIntervalUs;
+    }
+  }
+}
+
+/*! Loads sensor reports of the recorded session */
+bool LoadReports(const char* fname, std::vector<SensorReport>& reports) {
+  SessionReader reader;
+  if (!reader.Open(fname)) {
+    return false;
+  }
+  SessionRecord record;
+  while (reader.Next(record)) {
+    if (record.type == kSessionSensorReport && record.size == kSensorReportSize) {
+      SensorReport r;
+      r.size = record.size;
+      memcpy(r.data, record.data, record.size);
+      reports.push_back(r);
+    }
+  }
+  return !reports.empty();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  std::vector<SensorReport> reports;
+  bool recorded = argc > 1;
+  if (recorded) {
+    if (!LoadReports(argv[1], reports)) {
+      printf("Can't load reports of session %s\n", argv[1]);
+      return 1;
+    }
+  } else {
+    MakeReports(reports);
+  }
+
+  ImuIntegrator integrator;
+  ImuSample samples[kImuSamplesPerReport];
+  const double velo[3] = {0.0, 0.0, 0.0};
+  ImuQuaternion orientation = kIdentityQuaternion;
+  double integrated_ms = 0.0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int it = 0; it < kIterations; ++it) {
+    integrator.Reset();
+    for (auto& report: reports) {
+      size_t count = ParseSensorReport(report.data, report.size, samples);
+      for (size_t i = 0; i < count; ++i) {
+        integrated_ms += integrator.Integrate(samples[i], velo, orientation);
+      }
+    }
+  }
+  auto dur = std::chrono::steady_clock::now() - start;
+  double report_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(dur).count() /
+      static_cast<double>(reports.size() * kIterations);
+
+  // Every pass loses the first sample only, the rest is integrated by device ticks
+  double expected_ms = (reports.size() * kImuSamplesPerReport - 1) * kSampleIntervalUs * 0.001 * kIterations;
+  printf("Parse and integrate: %.1f ns per report (%.4f%% of %.0f ns budget)\n",
+      report_ns, report_ns / kReportBudgetNs * 100.0, kReportBudgetNs);
+  double norm = orientation.w * orientation.w + orientation.x * orientation.x +
+      orientation.y * orientation.y + orientation.z * orientation.z;
+  if (recorded) {
+    printf("Integrated %.1f ms of recorded session, quaternion norm %.9f\n",
+        integrated_ms / kIterations, norm);
+    return 0;
+  }
+  printf("Integrated %.1f ms of %.1f ms, quaternion norm %.9f\n",
+      integrated_ms, expected_ms, norm);
+  return integrated_ms == expected_ms ? 0 : 1;
+}
@@ -0,0 +1,234 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// End-to-end benchmark of the helmet rendering without a display. The GL 3.3
+// core context is created offscreen (QOffscreenSurface + FBO), so it runs on
+// build servers with Mesa llvmpipe, e.g. with QT_QPA_PLATFORM=offscreen.
+// Synthetic video frames go through the texture upload of HmdRenderer and the
+// pose follows a scripted head motion. Every projection mode is rendered for
+// the given number of frames.
+// Usage: psvr_render_bench [frames per mode] [video width] [video height] [eye scale]
+// Eye scale is the constant eye buffer scale per axis (1 by default), it's
+// chosen by ResolutionGovernor in the player.
+// Results are printed to stdout as CSV, one line per mode. CPU submit time is
+// the time of renderer calls of a frame, GPU time is measured by timer queries.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLFramebufferObject>
+#include <QQuaternion>
+#include <QSurfaceFormat>
+
+#include "hmd_renderer.h"
+#include "latency_histogram.h"
+
+namespace {
+
+const int kScreenWidth = 1920; //!< Screen of the helmet
+const int kScreenHeight = 1080;
+const int kDefaultFrames = 600;
+const int kDefaultVideoWidth = 3840;
+const int kDefaultVideoHeight = 2160;
+const int kWarmupFrames = 30; //!< Not measured: shaders are compiled and textures allocated
+const size_t kSyntheticFrames = 3; //!< Frames differ, so every upload changes the texture
+const double kFrameRate = 120.0; //!< Rate of the scripted motion
+const size_t kQueuedFrames = GpuTimer::kFramesInFlight - 1; //!< Frames queued to GPU as swap would allow
+
+const double kPi = 3.14159265358979323846;
+
+struct ModeSetup {
+  const char* name;
+  HmdRenderer::VideoProjectionMode mode;
+  int angle;
+};
+
+const ModeSetup kModes[] = {
+  {"mono360", HmdRenderer::Monoscopic, 360},
+  {"over_under360", HmdRenderer::OverUnder, 360},
+  {"side_by_side180", HmdRenderer::SideBySide, 180}
+};
+
+/*! Makes frames with moving gradients */
+std::vector<VideoDataInfoPtr> MakeFrames(int width, int height) {
+  std::vector<VideoDataInfoPtr> frames;
+  for (size_t f = 0; f < kSyntheticFrames; ++f) {
+    auto frame = std::make_shared<VideoDataInfo>(width, height);
+    unsigned char* data = frame->GetData();
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width; ++x) {
+        unsigned char* p = data + (y * width + x) * 3;
+        p[0] = static_cast<unsigned char>(x + f * 40);
+        p[1] = static_cast<unsigned char>(y + f * 40);
+        p[2] = static_cast<unsigned char>((x ^ y) + f * 40);
+      }
+    }
+    frames.push_back(frame);
+  }
+  return frames;
+}
+
+/*! View of the watching user at the frame: turns, nods and tilts */
+QMatrix4x4 ScriptedView(int frame) {
+  double t = frame / kFrameRate;
+  float yaw = static_cast<float>(70.0 * std::sin(2.0 * kPi * t / 11.0));
+  float pitch = static_cast<float>(20.0 * std::sin(2.0 * kPi * t / 7.0));
+  float roll = static_cast<float>(10.0 * std::sin(2.0 * kPi * t / 5.0));
+  QMatrix4x4 view;
+  view.rotate(QQuaternion::fromEulerAngles(pitch, yaw, roll));
+  return view;
+}
+
+/*! Overlay of the menu size, so the overlay pass is drawn as well */
+void SetupOverlay(HmdRenderer& renderer, std::vector<uint32_t>& pixels) {
+  const size_t size = 256;
+  pixels.assign(size * size, 0x80808080);
+  renderer.SetOverlayAtlas(kSpriteAtlasTexture, OverlayAtlas{size, size, pixels.data()});
+  std::vector<OverlayQuad> quads;
+  for (int i = 0; i < 5; ++i) {
+    OverlayQuad q = {kSpriteAtlasTexture, 560.0f + i * 160.0f, 860.0f, 160.0f, 160.0f,
+        0.0f, 0.0f, static_cast<float>(size), static_cast<float>(size)};
+    quads.push_back(q);
+  }
+  renderer.SetOverlay(quads);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  int frames_per_mode = argc > 1 ? atoi(argv[1]) : kDefaultFrames;
+  int video_width = argc > 2 ? atoi(argv[2]) : kDefaultVideoWidth;
+  int video_height = argc > 3 ? atoi(argv[3]) : kDefaultVideoHeight;
+  float eye_scale = argc > 4 ? static_cast<float>(atof(argv[4])) : 1.0f;
+  if (frames_per_mode <= 0 || video_width <= 0 || video_height <= 0 || eye_scale <= 0.0f) {
+    fprintf(stderr, "Usage: psvr_render_bench [frames per mode] [video width] [video height] "
+        "[eye scale]\n");
+    return 2;
+  }
+
+  QSurfaceFormat format;
+  format.setMajorVersion(3);
+  format.setMinorVersion(3);
+  format.setProfile(QSurfaceFormat::CoreProfile);
+  QSurfaceFormat::setDefaultFormat(format);
+  QGuiApplication app(argc, argv);
+
+  QOpenGLContext context;
+  context.setFormat(format);
+  QOffscreenSurface surface;
+  surface.setFormat(format);
+  surface.create();
+  if (!context.create() || !context.makeCurrent(&surface)) {
+    fprintf(stderr, "Failed to create OpenGL 3.3 context\n");
+    return 1;
+  }
+  fprintf(stderr, "OpenGL renderer: %s\n",
+      reinterpret_cast<const char*>(context.functions()->glGetString(GL_RENDERER)));
+
+  QOpenGLExtraFunctions* gl = context.extraFunctions();
+  QOpenGLFramebufferObject fbo(kScreenWidth, kScreenHeight);
+  fbo.bind();
+
+  std::vector<uint32_t> overlay_pixels;
+  std::vector<VideoDataInfoPtr> frames = MakeFrames(video_width, video_height);
+  int result = 0;
+  {
+    // Shader cache is off: every run compiles the same way
+    HmdRenderer renderer(QString(), &context);
+    SetupOverlay(renderer, overlay_pixels);
+    renderer.Initialize();
+    renderer.SetEyeScale(eye_scale);
+
+    printf("mode,frames,video_width,video_height,eye_scale,cpu_submit_p50_us,cpu_submit_p99_us,"
+        "gpu_p50_us,gpu_p99_us,gpu_frames,uploads_per_sec\n");
+    for (auto& setup: kModes) {
+      renderer.SetVideoProjectionMode(setup.mode);
+      renderer.SetVideoAngle(setup.angle);
+
+      LatencyHistogram submit;
+      LatencyHistogram gpu;
+      GLsync fences[kQueuedFrames] = {};
+      std::chrono::steady_clock::time_point start;
+      int total = kWarmupFrames + frames_per_mode;
+      for (int i = 0; i < total; ++i) {
+        // GPU is kept at most kQueuedFrames behind, as swap does in the player
+        GLsync& fence = fences[i % kQueuedFrames];
+        if (fence) {
+          gl->glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+          gl->glDeleteSync(fence);
+        }
+        if (i == kWarmupFrames) {
+          start = std::chrono::steady_clock::now();
+        }
+
+        auto submit_start = std::chrono::steady_clock::now();
+        // Results of warmup frames come in the first measured frames
+        bool gpu_ready = renderer.BeginFrame();
+        renderer.UploadVideo(frames[i % frames.size()]);
+        renderer.RenderEyes(kScreenWidth, kScreenHeight, ScriptedView(i));
+        renderer.RenderOverlay(kScreenWidth, kScreenHeight);
+        auto submit_end = std::chrono::steady_clock::now();
+        fence = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        if (i >= kWarmupFrames) {
+          submit.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+              submit_end - submit_start).count());
+        }
+        if (gpu_ready && i >= kWarmupFrames + static_cast<int>(GpuTimer::kFramesInFlight)) {
+          gpu.Record(renderer.GetGpuTimer().GetLastFrameTime());
+        }
+      }
+      gl->glFinish();
+      double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      // Results of the last frames
+      for (size_t i = 0; i < GpuTimer::kFramesInFlight; ++i) {
+        if (renderer.BeginFrame()) {
+          gpu.Record(renderer.GetGpuTimer().GetLastFrameTime());
+        }
+      }
+      for (auto& fence: fences) {
+        if (fence) {
+          gl->glDeleteSync(fence);
+        }
+      }
+
+      printf("%s,%d,%d,%d,%.2f,%llu,%llu,%llu,%llu,%llu,%.1f\n", setup.name, frames_per_mode,
+          video_width, video_height, eye_scale,
+          static_cast<unsigned long long>(submit.GetPercentile(50.0)),
+          static_cast<unsigned long long>(submit.GetPercentile(99.0)),
+          static_cast<unsigned long long>(gpu.GetPercentile(50.0)),
+          static_cast<unsigned long long>(gpu.GetPercentile(99.0)),
+          static_cast<unsigned long long>(gpu.GetCount()), frames_per_mode / seconds);
+      // No GPU time means the driver lacks timer queries: the run is incomplete
+      if (gpu.GetCount() == 0) {
+        result = 1;
+      }
+    }
+    renderer.Destroy();
+  }
+  fbo.release();
+  context.doneCurrent();
+  return result;
+}
@@ -0,0 +1,299 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Benchmark of tile blending for the sprite sizes used by InformationScreen:
+// 80x80 menu tiles and 160x160 warning tile on the 900x900 menu canvas.
+// Before timing, BlendRow is checked against the float blending formula
+// rounded to the nearest integer. The result must match it exactly for every
+// alpha, colour and destination value and for every row tail and alignment.
+// Then AddTile is compared with AddTileFloat, the blending before premultiplied
+// sprites, on the InformationScreen sprites. These differ by design: the old
+// blending truncates, the new one rounds (and rounds premultiplied sprite
+// colour), so a channel may differ by 1; the count of such pixels is printed.
+// Any larger difference or any mismatch is printed and the benchmark fails.
+// The kernel is chosen at compile time, so the check runs in tile_bench (SSE2
+// on x86-64), tile_bench_avx2 and tile_bench_scalar.
+// Usage: tile_bench [--check]  (--check skips timing)
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "tile.h"
+
+namespace {
+
+const size_t kCanvasWidth = 900;
+const size_t kCanvasHeight = 900;
+const int kIterations = 20000;
+const size_t kMaxReported = 10; //!< Mismatches printed before the check gives up
+
+/*! Blending as it was done before premultiplied sprites: float math per pixel */
+void AddTileFloat(std::vector<uint32_t>& canvas, size_t canvas_width,
+    const std::vector<uint32_t>& tile, size_t tile_width, size_t xpos, size_t ypos) {
+  size_t tile_height = tile.size() / tile_width;
+  for (size_t i = 0; i < tile_height; ++i) {
+    uint8_t* dst = (uint8_t*)(canvas.data() + (ypos + i) * canvas_width + xpos);
+    const uint8_t* src = (const uint8_t*)(tile.data() + i * tile_width);
+    for (size_t j = 0; j < tile_width; ++j, dst += 4, src += 4) {
+      float sol = src[3] / 255.0f;
+      float tra = 1.0f - sol;
+      dst[0] = dst[0] * tra + src[0] * sol;
+      dst[1] = dst[1] * tra + src[1] * sol;
+      dst[2] = dst[2] * tra + src[2] * sol;
+      dst[3] = 255 - (uint8_t)((255 - dst[3]) * tra);
+    }
+  }
+}
+
+/*! Reference blending of premultiplied pixels in double precision:
+dst = src + dst * (255 - src.alpha) / 255 per channel, rounded to the nearest
+and saturated. A transparent pixel leaves dst as is */
+uint32_t BlendReference(uint32_t dst, uint32_t src) {
+  uint32_t alpha = src >> 24;
+  if (alpha == 0) {
+    return dst;
+  }
+  uint32_t res = 0;
+  for (int shift = 0; shift < 32; shift += 8) {
+    double d = (dst >> shift) & 0xff;
+    double s = (src >> shift) & 0xff;
+    double v = std::floor(s + d * (255 - alpha) / 255.0 + 0.5);
+    res |= static_cast<uint32_t>(std::min(v, 255.0)) << shift;
+  }
+  return res;
+}
+
+/*! Blends src over dst with BlendRow and compares the row with the reference.
+Prints mismatches while their count is below kMaxReported */
+size_t CheckRow(uint32_t* dst, const uint32_t* src, size_t count, size_t& reported) {
+  std::vector<uint32_t> expected(dst, dst + count);
+  for (size_t i = 0; i < count; ++i) {
+    expected[i] = BlendReference(expected[i], src[i]);
+  }
+  BlendRow(dst, src, count);
+  size_t mismatches = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (dst[i] != expected[i]) {
+      ++mismatches;
+      if (reported < kMaxReported) {
+        ++reported;
+        fprintf(stderr, "MISMATCH: row of %zu, pixel %zu, src %08x: got %08x, expected %08x\n",
+            count, i, src[i], dst[i], expected[i]);
+      }
+    }
+  }
+  return mismatches;
+}
+
+/*! Checks BlendRow over all premultiplied source pixels (colour <= alpha)
+against every destination value, then over random mixed rows of every length
+up to 67 pixels at every alignment, so that SIMD blocks with transparent,
+opaque and translucent pixels and scalar tails are covered
+\return count of wrong pixels */
+size_t CheckBlendRow() {
+  size_t mismatches = 0;
+  size_t reported = 0;
+  std::vector<uint32_t> src;
+  std::vector<uint32_t> dst;
+  // Row of all colours of one alpha: its length (alpha + 1) runs over all tails
+  for (uint32_t alpha = 0; alpha < 256; ++alpha) {
+    src.clear();
+    for (uint32_t c = 0; c <= alpha; ++c) {
+      src.push_back(alpha << 24 | c << 16 | (alpha - c) << 8 | c / 2);
+    }
+    for (uint32_t d = 0; d < 256; ++d) {
+      dst.assign(src.size(), d << 24 | d << 16 | (255 - d) << 8 | (d * 7 & 0xff));
+      mismatches += CheckRow(dst.data(), src.data(), src.size(), reported);
+    }
+  }
+
+  // Pixels are premultiplied random ones, a quarter transparent and a quarter opaque
+  uint32_t seed = 12345;
+  auto next = [&seed]() {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+  };
+  const size_t kMaxLength = 67;
+  const size_t kMaxOffset = 8;
+  std::vector<uint32_t> src_buffer(kMaxLength + kMaxOffset);
+  std::vector<uint32_t> dst_buffer(kMaxLength + kMaxOffset);
+  for (int round = 0; round < 200; ++round) {
+    for (size_t length = 0; length <= kMaxLength; ++length) {
+      for (size_t offset = 0; offset < kMaxOffset; ++offset) {
+        for (size_t i = 0; i < length; ++i) {
+          uint32_t kind = next() & 3;
+          uint32_t alpha = kind == 0 ? 0 : (kind == 1 ? 255 : next() & 0xff);
+          uint32_t pixel = alpha << 24;
+          for (int shift = 0; shift < 24; shift += 8) {
+            pixel |= (alpha ? next() % (alpha + 1) : 0) << shift;
+          }
+          src_buffer[offset + i] = pixel;
+          dst_buffer[offset + i] = next();
+        }
+        mismatches += CheckRow(dst_buffer.data() + offset, src_buffer.data() + offset,
+            length, reported);
+      }
+    }
+  }
+  return mismatches;
+}
+
+bool LoadSprite(const std::string& name, std::vector<uint32_t>& data) {
+  std::ifstream f(std::string(PSVR_SPRITE_DIR) + "/" + name, std::ios_base::binary);
+  if (!f) {
+    return false;
+  }
+  f.seekg(0, std::ios_base::end);
+  data.resize(static_cast<size_t>(f.tellg()) / sizeof(uint32_t));
+  f.seekg(0);
+  f.read(reinterpret_cast<char*>(data.data()), data.size() * sizeof(uint32_t));
+  return static_cast<bool>(f);
+}
+
+/*! Compares AddTile with AddTileFloat for the sprite over the transparent
+canvas and opaque canvases of every grey level. Colour of these canvases is
+the same with and without premultiplied alpha, so results are comparable.
+\param off_by_one count of pixels with a channel differing by 1 (truncation
+of AddTileFloat against rounding of AddTile)
+\return count of pixels differing by more than 1 */
+size_t CheckAgainstFloat(const std::string& name, size_t width, size_t& off_by_one,
+    size_t& reported) {
+  std::vector<uint32_t> raw;
+  if (!LoadSprite(name, raw)) {
+    fprintf(stderr, "MISMATCH: can't load sprite %s\n", name.c_str());
+    return 1;
+  }
+  TileImage sprite;
+  MakeTileImage(sprite, raw, width);
+  TileRect whole = {0, 0, sprite.width, sprite.height};
+
+  size_t mismatches = 0;
+  std::vector<uint32_t> expected;
+  std::vector<uint32_t> result;
+  for (int level = -1; level < 256; ++level) {
+    uint32_t c = static_cast<uint32_t>(level);
+    uint32_t background = level < 0 ? 0 : 0xff000000 | c << 16 | (255 - c) << 8 | (c * 7 & 0xff);
+    expected.assign(raw.size(), background);
+    result.assign(raw.size(), background);
+    AddTileFloat(expected, sprite.width, raw, width, 0, 0);
+    AddTile(result, sprite.width, sprite, 0, 0, whole);
+    for (size_t i = 0; i < raw.size(); ++i) {
+      int max_diff = 0;
+      for (int shift = 0; shift < 32; shift += 8) {
+        int diff = static_cast<int>((result[i] >> shift) & 0xff) -
+            static_cast<int>((expected[i] >> shift) & 0xff);
+        max_diff = std::max(max_diff, std::abs(diff));
+      }
+      if (max_diff == 1) {
+        ++off_by_one;
+      } else if (max_diff > 1) {
+        ++mismatches;
+        if (reported < kMaxReported) {
+          ++reported;
+          fprintf(stderr, "MISMATCH: %s over %08x, pixel %zu, src %08x: got %08x, float %08x\n",
+              name.c_str(), background, i, raw[i], result[i], expected[i]);
+        }
+      }
+    }
+  }
+  return mismatches;
+}
+
+template<typename Func>
+double MeasureNs(Func func) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) {
+    func();
+  }
+  auto dur = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(dur).count() /
+      static_cast<double>(kIterations);
+}
+
+void Bench(const std::string& name, size_t width) {
+  std::vector<uint32_t> raw;
+  if (!LoadSprite(name, raw)) {
+    printf("%-20s can't load sprite\n", name.c_str());
+    return;
+  }
+
+  TileImage sprite;
+  MakeTileImage(sprite, raw, width);
+  std::vector<uint32_t> canvas(kCanvasWidth * kCanvasHeight, 0x80402010);
+  TileRect whole = {0, 0, kCanvasWidth, kCanvasHeight};
+
+  double float_ns = MeasureNs([&]() {
+    AddTileFloat(canvas, kCanvasWidth, raw, width, 250, 320);
+  });
+  double tile_ns = MeasureNs([&]() {
+    AddTile(canvas, kCanvasWidth, sprite, 250, 320, whole);
+  });
+  printf("%-20s %3zux%-3zu float %9.1f ns  premultiplied %9.1f ns  x%.1f\n",
+      name.c_str(), sprite.width, sprite.height, float_ns, tile_ns,
+      tile_ns > 0.0 ? float_ns / tile_ns : 0.0);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+#if defined(__AVX2__) && !defined(PSVR_TILE_SCALAR)
+  printf("Blending kernel: AVX2\n");
+#elif defined(__SSE2__) && !defined(PSVR_TILE_SCALAR)
+  printf("Blending kernel: SSE2\n");
+#else
+  printf("Blending kernel: scalar\n");
+#endif
+
+  size_t mismatches = CheckBlendRow();
+  if (mismatches > 0) {
+    fprintf(stderr, "FAILED: BlendRow differs from the reference in %zu pixels\n", mismatches);
+    return 1;
+  }
+  printf("BlendRow matches the reference exactly\n");
+
+  const char* sprites[] = {"selector.data", "play.data", "invert_0.data", "no_vr.data"};
+  const size_t widths[] = {80, 80, 80, 160};
+  size_t reported = 0;
+  for (size_t i = 0; i < 4; ++i) {
+    size_t off_by_one = 0;
+    mismatches += CheckAgainstFloat(sprites[i], widths[i], off_by_one, reported);
+    printf("%-20s AddTile differs from float blending by 1 in %zu pixels of 257 canvases\n",
+        sprites[i], off_by_one);
+  }
+  if (mismatches > 0) {
+    fprintf(stderr, "FAILED: AddTile differs from float blending by more than 1 in %zu pixels\n",
+        mismatches);
+    return 1;
+  }
+  if (argc > 1 && strcmp(argv[1], "--check") == 0) {
+    return 0;
+  }
+
+  Bench("selector.data", 80);
+  Bench("play.data", 80);
+  Bench("invert_0.data", 80);
+  Bench("no_vr.data", 160);
+  return 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef COALESCING_NOTIFIER_PSVR_PLAYER_04072024
+#define COALESCING_NOTIFIER_PSVR_PLAYER_04072024
+
+#include <atomic>
+#include <mutex>
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+
+const int kUiRefreshPeriodMs = 16; //!< Period of interface updates, about 60 Hz
+
+/*! Merges high-rate notifications from any threads into signals in the thread
+of the notifier. There is at most one pending event in the queue, and signals
+are emitted not more often than once per period */
+class CoalescingNotifier: public QObject {
+  Q_OBJECT
+
+ public:
+  explicit CoalescingNotifier(int period_ms = kUiRefreshPeriodMs, QObject* parent = nullptr);
+
+  /*! Requests Notified signal. Can be called from any thread */
+  void Notify();
+
+  /*! Returns number of Notify calls and emitted signals */
+  void GetStatistics(uint64_t& notifies, uint64_t& signals_count) const;
+
+ signals:
+  void Notified();
+
+ private slots:
+  void Deliver();
+
+ private:
+  std::atomic_bool pending_; //!< Event is queued or delayed by period
+  std::atomic<uint64_t> notifies_;
+  uint64_t signals_;
+  int period_ms_;
+  QElapsedTimer last_signal_;
+  QTimer delay_timer_;
+};
+
+
+/*! Notifier carrying the latest value. The receiver takes it by Get */
+template<typename T>
+class CoalescingValue: public CoalescingNotifier {
+ public:
+  explicit CoalescingValue(int period_ms = kUiRefreshPeriodMs, QObject* parent = nullptr):
+      CoalescingNotifier(period_ms, parent), value_() {}
+
+  /*! Stores the value and requests notification. Can be called from any thread */
+  void Set(const T& value) {
+    {
+      std::lock_guard<std::mutex> lk(lock_);
+      value_ = value;
+    }
+    Notify();
+  }
+
+  T Get() const {
+    std::lock_guard<std::mutex> lk(lock_);
+    return value_;
+  }
+
+ private:
+  mutable std::mutex lock_;
+  T value_;
+};
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef DEVICE_MANAGER_PSVR_PLAYER_05072024
+#define DEVICE_MANAGER_PSVR_PLAYER_05072024
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <QObject>
+
+/*! Interfaces of the connected helmet */
+struct HelmetInterfaces {
+  bool present = false; //!< Helmet is connected (or replayed)
+  std::string sensor_path; //!< hidapi path of the sensor interface
+  std::string control_path; //!< hidapi path of the control interface
+  std::string serial;
+};
+
+/*! Watches for connection of the helmet. The helmet is enumerated once on
+start and then after hotplug events of hidraw devices (udev events on Linux,
+kernel uevents if udev isn't running). Without hotplug events the enumeration is repeated periodically.
+Everything is done in the background thread, changes come as HelmetChanged
+signal in the thread of the manager */
+class DeviceManager: public QObject {
+  Q_OBJECT
+
+ public:
+  DeviceManager();
+  ~DeviceManager();
+
+  /*! Starts watching.
+  \param virtual_helmet the helmet is replayed: it's always present */
+  void Start(bool virtual_helmet);
+  void Stop();
+
+  /*! Returns the last enumerated interfaces */
+  HelmetInterfaces GetInterfaces() const;
+
+ signals:
+  void HelmetChanged();
+
+ private:
+  const int kSettleMs = 50; //!< Quiet time after hotplug event. The helmet creates several hidraw nodes at once
+  const int kPollIntervalMs = 2000; //!< Enumeration interval without hotplug events
+
+  mutable std::mutex lock_;
+  HelmetInterfaces interfaces_;
+  std::thread thread_;
+  std::atomic_bool stop_;
+  std::condition_variable stop_cv_;
+  int stop_fd_; //!< eventfd for waking up the hotplug thread. Or -1
+
+  /*! Enumerates the helmet and notifies about changes */
+  void Update();
+
+  void WatchHotplug();
+  void WatchPolling();
+};
+
+/*! Finds interfaces of the helmet by hidapi enumeration */
+HelmetInterfaces EnumerateHelmet();
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef DISTORTION_MESH_PSVR_PLAYER_07072024
+#define DISTORTION_MESH_PSVR_PLAYER_07072024
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*! Сетка экрана, на которую проецируется видео. Вершины общие для соседних
+треугольников и рисуются по индексам */
+struct DistortionMesh {
+  std::vector<float> vertices; //!< Тройки x, y, z в плоскости z = -1
+  std::vector<uint16_t> indices; //!< Тройки индексов треугольников
+};
+
+/*! Возвращает коэффициент коррекции дисторсии линз для расстояния от центра
+экрана. Совпадает с FixDistorsion из shader/sphere.vert */
+double GetDistortionFactor(double len);
+
+/*! Вычисляет положения линий сетки на отрезке [-half_size, half_size].
+Две линии касаются края коррекции дисторсии (окружности) на осях, часть
+сетки за ними рисуется одной ячейкой. Внутри линии сгущаются там, где
+сильнее кривизна коррекции, и разрежаются в центре.
+\param count количество линий (не меньше 2)
+\param half_size половина размера сетки
+\param lines положения линий по возрастанию */
+void GenerateMeshLines(size_t count, double half_size, std::vector<double>& lines);
+
+/*! Создаёт сетку экрана [-half_size, half_size] x [-half_size, half_size].
+Внутренние вершины рядом с краем коррекции переносятся на его окружность, и
+ни один треугольник не соединяет вершины внутри края с вершинами за ним
+\param count количество линий по каждой оси. Вершин count * count
+\param half_size половина размера сетки
+\param mesh созданная сетка */
+void GenerateDistortionMesh(size_t count, double half_size, DistortionMesh& mesh);
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef FRAME_HUD_PSVR_PLAYER_11072024
+#define FRAME_HUD_PSVR_PLAYER_11072024
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "frame_log.h"
+#include "osd_text.h"
+
+/*! Экран времени кадров (HUD) для поиска рывков в шлеме. Показывает за
+период обновления среднюю и худшую длительность кадра, время CPU и GPU,
+загрузку кадра видео, возраст положения шлема и пропущенные кадры видео.
+Под текстом два графика последних периодов: худший кадр и пропуски видео.
+Рисуется ячейками наложения */
+class FrameHud {
+ public:
+  /*! \param glyphs атлас символов. Должен существовать всё время жизни экрана
+  \param first_cell номер первой ячейки наложения. Экран занимает
+  GetCellCount() ячеек */
+  FrameHud(const GlyphAtlas& glyphs, size_t first_cell);
+
+  static size_t GetCellCount() { return kLines * kLineLength + kGraphColumns * 4; }
+
+  /*! Учитывает кадр в текущем периоде */
+  void AddFrame(const FrameRecord& record);
+
+  /*! Завершает период: обновляет текст и добавляет столбцы графиков */
+  void Update();
+
+  void SetVisible(bool visible);
+  bool IsVisible() const { return visible_; }
+
+  /*! Добавляет в cells изменившиеся с прошлого вызова ячейки
+  \param xpos, ypos позиция экрана на поле наложения */
+  void TakeChangedCells(std::vector<OverlayCell>& cells, size_t xpos, size_t ypos);
+
+ private:
+  FrameHud(const FrameHud&) = delete;
+  FrameHud& operator=(const FrameHud&) = delete;
+
+  static const size_t kLines = 4;
+  static const size_t kLineLength = 26;
+  static const size_t kGraphColumns = 16;
+  static const size_t kGraphWidth = 280;
+  static const size_t kGraphHeight = 60;
+  static const size_t kGraphGap = 20; //!< Расстояние между графиками и до текста
+  const float kGraphFrameMs = 50.0f; //!< Длительность кадра на всю высоту графика
+  const float kGraphDrops = 10.0f; //!< Пропуски видео за период на всю высоту графика
+
+  /*! Сумма и максимум значений за период */
+  struct Accumulator {
+    uint64_t sum;
+    uint64_t max;
+    uint64_t count;
+
+    void Add(uint64_t value);
+    double GetAverageMs() const;
+    double GetMaxMs() const;
+  };
+
+  std::vector<OsdText> lines_;
+  OsdGraph frame_graph_; //!< Худший кадр периода
+  OsdGraph drops_graph_; //!< Пропуски видео за период
+  bool visible_;
+  Accumulator interval_;
+  Accumulator cpu_;
+  Accumulator gpu_;
+  Accumulator upload_;
+  Accumulator gpu_upload_;
+  Accumulator pose_age_;
+  uint64_t dropped_video_;
+
+  void Clear();
+};
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef FRAME_LOG_PSVR_PLAYER_11072024
+#define FRAME_LOG_PSVR_PLAYER_11072024
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gpu_timer.h"
+
+/*! Timing of one rendered frame. Times are in microseconds */
+struct FrameRecord {
+  uint64_t frame; //!< Frame number from 1. 0 for empty record
+  uint64_t time_us; //!< Start of painting from the first frame
+  uint64_t interval_us; //!< Time from the start of the previous frame
+  uint64_t cpu_us; //!< Painting time on CPU
+  uint64_t upload_us; //!< Video texture upload on CPU
+  uint64_t swap_us; //!< From the end of painting to the frame swap
+  bool gpu_valid; //!< GPU times are measured: the driver supports timer queries and results were ready
+  uint64_t gpu_us[kGpuStageCount];
+  uint64_t pose_age_us; //!< Age of the helmet pose at its reading
+  uint64_t dropped_video; //!< Decoded video frames replaced before upload since the previous frame
+  float eye_scale; //!< Eye buffer scale per axis the frame was rendered with
+};
+
+/*! Returns GPU time of all stages of the frame */
+uint64_t GetGpuFrameTime(const FrameRecord& record);
+
+/*! Writes frame records into CSV file. The render thread only queues records,
+the file is written by the background thread, so file output doesn't delay
+frames being measured */
+class FrameLog {
+ public:
+  FrameLog();
+  ~FrameLog();
+
+  /*! Creates the file, writes the header and starts the writer thread */
+  bool Open(const std::string& fname);
+
+  /*! Writes queued records and closes the file */
+  void Close();
+
+  /*! Queues the record. Doesn't wait for the file */
+  void Write(const FrameRecord& record);
+
+ private:
+  FrameLog(const FrameLog&) = delete;
+  FrameLog& operator=(const FrameLog&) = delete;
+
+  const size_t kMaxQueued = 4096; //!< Records over this count are dropped if the writer falls behind
+
+  std::mutex lock_;
+  std::condition_variable cv_;
+  std::vector<FrameRecord> queue_; //!< Swapped with the writer's buffer, so capacity is reused
+  bool stop_;
+  uint64_t lost_; //!< Records dropped on full queue
+  std::ofstream file_;
+  std::thread writer_;
+
+  void WriteRecords();
+};
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef GPU_TIMER_PSVR_PLAYER_10072024
+#define GPU_TIMER_PSVR_PLAYER_10072024
+
+#include <string>
+
+#include <QOpenGLExtraFunctions>
+
+#include "latency_histogram.h"
+
+/*! Этапы отрисовки кадра, время которых измеряется на GPU */
+enum GpuStage {
+  kGpuUpload, //!< Загрузка кадра видео в текстуру
+  kGpuLeftEye,
+  kGpuRightEye,
+  kGpuResolve, //!< Растягивание уменьшенного буфера глаз на экран
+  kGpuOverlay,
+  kGpuStageCount
+};
+
+/*! Измеряет время этапов отрисовки на GPU запросами GL_TIME_ELAPSED. Запросы
+идут по кольцу из нескольких кадров, результаты забираются через несколько
+кадров, когда они уже готовы, поэтому отрисовка не ждёт GPU. Если результаты
+ещё не готовы, кадр пропускается. Используется в потоке OpenGL при текущем
+контексте */
+class GpuTimer {
+ public:
+  static const size_t kFramesInFlight = 4; //!< Через столько кадров результаты запросов обычно готовы
+
+  GpuTimer();
+
+  /*! Создаёт запросы, если драйвер поддерживает измерение времени */
+  void Initialize();
+
+  /*! Удаляет запросы */
+  void Destroy();
+
+  /*! Начинает кадр: забирает готовые результаты кадра, место которого в
+  кольце занимает новый кадр (kFramesInFlight кадров назад)
+  \return результаты этого кадра получены и выдаются GetLastTime */
+  bool BeginFrame();
+
+  /*! Начинает измерение этапа. Этапы не вкладываются друг в друга */
+  void BeginStage(GpuStage stage);
+  void EndStage();
+
+  /*! Добавляет время от конца отрисовки до вывода кадра, измеренное на CPU */
+  void AddSwapTime(uint64_t time_us);
+
+  /*! Выдаёт время этапа последнего измеренного кадра, мкс. 0, если этап
+  в кадре не выполнялся */
+  uint64_t GetLastTime(GpuStage stage) const { return last_[stage]; }
+
+  /*! Выдаёт время всех этапов последнего измеренного кадра, мкс */
+  uint64_t GetLastFrameTime() const { return frames_time_.GetLast(); }
+
+  /*! Выдаёт скользящие процентили этапов, по строке на этап */
+  std::string Format() const;
+
+ private:
+  struct FrameQueries {
+    GLuint queries[kGpuStageCount];
+    bool used[kGpuStageCount];
+  };
+
+  QOpenGLExtraFunctions* gl_;
+  bool supported_;
+  FrameQueries frames_[kFramesInFlight];
+  size_t current_;
+  int active_; //!< Измеряемый этап или -1
+  RollingPercentiles stages_[kGpuStageCount];
+  uint64_t last_[kGpuStageCount]; //!< Время этапов последнего измеренного кадра
+  RollingPercentiles frames_time_;
+  RollingPercentiles swap_;
+  uint64_t dropped_; //!< Кадры, результаты которых не были готовы
+};
+
+#endif
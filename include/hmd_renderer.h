@@ -0,0 +1,244 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef HMD_RENDERER_PSVR_PLAYER_12072024
+#define HMD_RENDERER_PSVR_PLAYER_12072024
+
+#include <atomic>
+#include <bitset>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QMatrix4x4>
+#include <QOpenGLBuffer>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLTexture>
+#include <QOpenGLVertexArrayObject>
+#include <QString>
+
+#include "distortion_mesh.h"
+#include "gpu_timer.h"
+#include "overlay.h"
+#include "program_cache.h"
+#include "shader_permutations.h"
+#include "video_data.h"
+
+/*! Отрисовка кадра шлема: видео на сфере (или экране) для обоих глаз и
+наложение поверх. Не зависит от окна: рисует в текущий буфер кадра текущего
+контекста, поэтому используется и виджетом шлема, и тестом производительности
+без экрана (bench/render_bench.cpp). Методы отрисовки вызываются в потоке
+OpenGL, настройки задаются из потока интерфейса */
+class HmdRenderer {
+ public:
+  enum VideoProjectionMode {
+    Monoscopic,
+    OverUnder,
+    SideBySide
+  };
+
+  /*! \param cache_directory каталог кэша программ шейдеров. Пустой выключает кэш
+  \param parent родитель программ шейдеров */
+  HmdRenderer(const QString& cache_directory, QObject* parent);
+  ~HmdRenderer();
+
+  /*! Создаёт ресурсы OpenGL в текущем контексте */
+  void Initialize();
+
+  /*! Удаляет ресурсы OpenGL. Контекст должен быть текущим */
+  void Destroy();
+
+  /*! Начинает кадр
+  \return получено время GPU кадра, нарисованного GpuTimer::kFramesInFlight
+  кадров назад (выдаётся GetGpuTimer().GetLastTime) */
+  bool BeginFrame();
+
+  /*! Загружает кадр видео в текстуру. Без кадра остаётся прежняя текстура */
+  void UploadVideo(const VideoDataInfoPtr& frame);
+
+  /*! Рисует видео для обоих глаз: левый глаз в левой половине области. При
+  масштабе буфера глаз, отличном от 1, глаза рисуются в буфер кадра
+  уменьшенного (увеличенного) размера, который затем растягивается на область
+  \param width, height область отрисовки
+  \param model_view поворот вида по положению шлема */
+  void RenderEyes(int width, int height, const QMatrix4x4& model_view);
+
+  /*! Рисует наложение поверх обоих глаз. Вершины изменившихся прямоугольников
+  и ячеек загружаются перед отрисовкой */
+  void RenderOverlay(int width, int height);
+
+  GpuTimer& GetGpuTimer() { return gpu_timer_; }
+  const GpuTimer& GetGpuTimer() const { return gpu_timer_; }
+
+  /*! Масштаб буфера глаз по каждой оси относительно области отрисовки */
+  float GetEyeScale() const { return eye_scale_; }
+  void SetEyeScale(float scale) { eye_scale_ = scale; }
+
+  float GetFOV() const { return fov_; }
+  void SetFOV(float fov) { fov_ = fov; }
+
+  int GetVideoAngle() const { return video_angle_; }
+  void SetVideoAngle(int angle) { video_angle_ = angle; }
+
+  VideoProjectionMode GetVideoProjectionMode() const { return video_projection_mode_; }
+  void SetVideoProjectionMode(VideoProjectionMode mode) { video_projection_mode_ = mode; }
+
+  bool GetInvertStereo() const { return invert_stereo_; }
+  void SetInvertStereo(bool invert) { invert_stereo_ = invert; }
+
+  void SetRGBWorkaround(bool enabled) { rgb_workaround_ = enabled; }
+  void SetCylinderScreen(bool value) { cylinder_screen_ = value; }
+
+  /*! Включает отладочную коррекцию дисторсии по точкам (DEBUG_DISTORSION в shader/sphere.vert) */
+  void SetDebugDistortion(bool value) { debug_distortion_ = value; }
+
+  void SetEyesDistance(float disp) { eyes_disp_ = disp; }
+  void SetHorizontLevel(float horz) { horizont_level_ = horz; }
+
+  /*! Задаёт атлас картинок наложения для текстуры kind. Данные атласа
+  должны существовать всё время жизни отрисовщика */
+  void SetOverlayAtlas(OverlayTexture kind, const OverlayAtlas& atlas) { overlay_atlases_[kind] = atlas; }
+
+  /*! Задаёт файл тестового экрана: height * width пикселей rgba на всё
+  поле наложения. Файл отображается в память только на время загрузки
+  текстуры, в текстуру попадает лишь область с непрозрачными пикселями */
+  void SetTestScreenFile(const QString& fname, size_t width, size_t height);
+
+  /*! Задаёт прямоугольники наложения (меню, предупреждения и т.д.). Если
+  прямоугольников нет, проход наложения не выполняется */
+  void SetOverlay(const std::vector<OverlayQuad>& quads);
+
+  /*! Обновляет ячейки наложения. Остальные ячейки и прямоугольники
+  наложения не пересчитываются */
+  void UpdateOverlayCells(const std::vector<OverlayCell>& cells);
+
+ private:
+  HmdRenderer(const HmdRenderer&) = delete;
+  HmdRenderer& operator=(const HmdRenderer&) = delete;
+
+  /*! Возможности шейдера сферы, биты набора для sphere_shaders_ */
+  enum SphereFeature {
+    kCylinderScreenFeature = 1, //!< CYLINDER_SCREEN
+    kFullSphereFeature = 2, //!< FULL_SPHERE
+    kDebugDistortionFeature = 4 //!< DEBUG_DISTORSION
+  };
+
+  /*! Возможности шейдера наложения, биты набора для overlay_shaders_ */
+  enum OverlayFeature {
+    kPremultiplyFeature = 1 //!< PREMULTIPLY
+  };
+
+  static const size_t kMeshLines = 33; //!< Количество линий сетки экрана по каждой оси
+  const double kMeshHalfSize = 2.0; //!< Половина размера сетки экрана
+
+  static const size_t kOverlayCellSize = 120; //!< Максимальный размер ячейки прямоугольника наложения в пикселях. Дисторсия корректируется по вершинам ячеек
+  static const size_t kOverlayMargin = 16; //!< Расширение прямоугольников наложения в пикселях, чтобы сдвинутые зелёный и синий цвет не обрезались
+  static const size_t kOverlayVertexSize = 10; //!< Количество float-ов на вершину наложения
+  static const size_t kCellVertices = 6; //!< Количество вершин на ячейку наложения (ячейка не разбивается)
+
+  /*! Диапазон вершин наложения, рисуемых с одной текстурой */
+  struct OverlayRange {
+    int first;
+    int count;
+  };
+
+  static const int kMinEyeBufferSize = 16; //!< Минимальный размер буфера глаз по каждой оси
+  const float kEyeScaleTolerance = 0.001f; //!< Масштаб буфера глаз ближе к 1 считается равным 1
+
+  QOpenGLExtraFunctions* gl_;
+  ProgramBinaryCache program_cache_;
+  ShaderPermutations sphere_shaders_;
+  ShaderPermutations overlay_shaders_;
+  GpuTimer gpu_timer_;
+
+  DistortionMesh screen_mesh_; //!< Сетка экрана, сгущённая к краю линз
+  QOpenGLBuffer screen_vbo_;
+  QOpenGLBuffer screen_ibo_;
+  QOpenGLVertexArrayObject screen_vao_;
+  QOpenGLTexture* video_tex_;
+  std::atomic<float> eye_scale_;
+  std::unique_ptr<QOpenGLFramebufferObject> eye_fbo_; //!< Буфер глаз при масштабе, отличном от 1
+
+  float fov_;
+  int video_angle_;
+  VideoProjectionMode video_projection_mode_;
+  bool invert_stereo_;
+  bool rgb_workaround_;
+  bool cylinder_screen_;
+  bool debug_distortion_;
+  std::atomic<float> eyes_disp_; //!< Смещение для компенсации меж-глазного расстояния
+  std::atomic<float> horizont_level_; //!< Смещение горизонта
+
+  QOpenGLBuffer overlay_vbo_;
+  QOpenGLVertexArrayObject overlay_vao_;
+  QOpenGLBuffer cells_vbo_; //!< Вершины ячеек наложения: у каждой ячейки постоянное место
+  QOpenGLVertexArrayObject cells_vao_;
+  std::shared_ptr<QOpenGLTexture> overlay_tex_[kOverlayTextureCount];
+  OverlayRange overlay_ranges_[kOverlayTextureCount];
+  OverlayAtlas overlay_atlases_[kOverlayTextureCount];
+  QString test_screen_file_;
+  size_t test_screen_width_;
+  size_t test_screen_height_;
+  OverlayQuad test_screen_quad_; //!< Прямоугольник тестового экрана. Ширина нулевая, если тестового экрана нет
+  std::vector<OverlayQuad> overlay_quads_;
+  bool overlay_changed_; //!< Признак, что прямоугольники наложения изменились и вершины нужно пересчитать
+  std::vector<OverlayCell> overlay_cells_; //!< Изменённые ячейки, ещё не загруженные в cells_vbo_
+  std::bitset<kOverlayCellCount> cells_visible_; //!< Ячейки с непустым прямоугольником
+  size_t cells_used_; //!< Количество рисуемых ячеек (номер последней видимой + 1). 0, если видимых нет
+  std::mutex overlay_lock_; //!< Блокировка для overlay_quads_, overlay_changed_ и overlay_cells_
+
+  /*! Загружает кадр в текстуру видео, меняя её размер при необходимости */
+  void UploadVideoTexture(VideoDataInfo& frame);
+
+  void RenderEye(int eye, int width, int height, const QMatrix4x4& model_view);
+
+  /*! Растягивает буфер глаз размером eye_width * eye_height на область
+  width * height буфера кадра target */
+  void ResolveEyes(int eye_width, int eye_height, int width, int height, GLuint target);
+
+  void InitializeOverlay();
+
+  /*! Задаёт формат вершин наложения для буфера vbo в массиве вершин vao */
+  void SetupOverlayAttributes(QOpenGLBuffer& vbo, QOpenGLVertexArrayObject& vao);
+
+  /*! Создаёт текстуру наложения из области rect данных data
+  \param data пиксели rgba
+  \param stride длина строки данных в пикселях
+  \param rect область данных, загружаемая в текстуру */
+  void CreateOverlayTexture(OverlayTexture kind, const uint32_t* data, size_t stride,
+      const TileRect& rect);
+
+  /*! Загружает тестовый экран в текстуру и определяет его прямоугольник */
+  void LoadTestScreen();
+
+  /*! Пересчитывает вершины наложения, если прямоугольники изменились */
+  void UpdateOverlayVertices();
+
+  /*! Загружает в cells_vbo_ вершины изменённых ячеек наложения */
+  void UpdateOverlayCellVertices();
+
+  /*! Добавляет в vertices вершины прямоугольника quad, разбитого на части не
+  больше cell_size пикселей */
+  void AddOverlayQuadVertices(std::vector<float>& vertices, const OverlayQuad& quad,
+      float tex_width, float tex_height, float cell_size = kOverlayCellSize);
+
+  void DrawOverlay(int width, int height);
+};
+
+#endif
@@ -19,128 +19,124 @@
 #ifndef PSVR_HMDWIDGET_H
 #define PSVR_HMDWIDGET_H
 
-#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
 
 #include <QOpenGLWidget>
-#include <QOpenGLShaderProgram>
-#include <QOpenGLBuffer>
-#include <QOpenGLVertexArrayObject>
-#include <QOpenGLTexture>
-#include <QOpenGLFunctions>
-#include <QOpenGLFramebufferObject>
 
+#include "frame_hud.h"
+#include "frame_log.h"
+#include "hmd_renderer.h"
+#include "resolution_governor.h"
 #include "videoplayer.h"
 #include "psvr.h"
+#include "overlay.h"
 
-/*! Класс-виджет для обработки изображения, наложения и т.д.
-В нём оборачиваются все функции по работе с OpenGL */
+/*! Класс-виджет шлема. Кадр рисуется отрисовщиком HmdRenderer, виджет
+передаёт ему кадр видео и положение шлема и измеряет время кадров */
 class HMDWidget : public QOpenGLWidget
 {
 	Q_OBJECT
 
 	public:
-		enum VideoProjectionMode
-		{
-			Monoscopic,
-			OverUnder,
-			SideBySide
-		};
+		typedef HmdRenderer::VideoProjectionMode VideoProjectionMode;
 
 	private:
 		VideoPlayer *video_player;
 		PsvrSensors *psvr;
 
+	public:
+		HMDWidget(VideoPlayer *video_player, PsvrSensors *psvr, QWidget *parent = 0);
+		~HMDWidget();
 
-		QOpenGLFunctions *gl;
-
-		QOpenGLShaderProgram *sphere_shader;
-		QOpenGLShaderProgram *distortion_shader;
-
-		QOpenGLBuffer cube_vbo;
-		QOpenGLVertexArrayObject cube_vao;
-
-		QOpenGLTexture *video_tex;
-    std::shared_ptr<QOpenGLTexture> info_tex_; //!< Текстура с информацией: прогресс, настроики и т.д.
+		float GetFOV()											{ return renderer_.GetFOV(); }
+		void SetFOV(float fov)									{ renderer_.SetFOV(fov); }
 
+		int GetVideoAngle()										{ return renderer_.GetVideoAngle(); }
+		void SetVideoAngle(int angle)							{ renderer_.SetVideoAngle(angle); }
 
-		/*QOpenGLBuffer screen_vbo;
-		QOpenGLVertexArrayObject screen_vao;
-		QOpenGLFramebufferObject *fbo;*/
+    void SetEyesDistance(float disp) { renderer_.SetEyesDistance(disp); }
 
-		float fov;
-		float barrel_power;
+    void SetCylinderScreen(bool value) { renderer_.SetCylinderScreen(value); }
 
-		int video_angle;
-		VideoProjectionMode video_projection_mode;
-		bool invert_stereo;
+    /*! Включает отладочную коррекцию дисторсии по точкам (DEBUG_DISTORSION в shader/sphere.vert) */
+    void SetDebugDistortion(bool value) { renderer_.SetDebugDistortion(value); }
 
-		bool rgb_workaround;
-    bool cylinder_screen_;
+		VideoProjectionMode GetVideoProjectionMode()			{ return renderer_.GetVideoProjectionMode(); }
+		void SetVideoProjectionMode(VideoProjectionMode mode)	{ renderer_.SetVideoProjectionMode(mode); }
 
-		//void CreateFBO(int width, int height);
-		void UpdateTexture();
-		void RenderEye(int eye);
+		bool GetInvertStereo()									{ return renderer_.GetInvertStereo(); }
+		void SetInvertStereo(bool invert)						{ renderer_.SetInvertStereo(invert); }
 
-	public:
-		HMDWidget(VideoPlayer *video_player, PsvrSensors *psvr, QWidget *parent = 0);
-		~HMDWidget();
+		void SetRGBWorkaround(bool enabled)						{ renderer_.SetRGBWorkaround(enabled); }
 
-    static const int kInfoWidth = 1920;
-    static const int kInfoHeight = 1920;
-    using InfoTextureRow = uint32_t[kInfoWidth];
+    /*! Задаёт атлас картинок наложения для текстуры kind. Данные атласа
+    должны существовать всё время жизни виджета */
+    void SetOverlayAtlas(OverlayTexture kind, const OverlayAtlas& atlas) { renderer_.SetOverlayAtlas(kind, atlas); }
 
-		float GetFOV()											{ return fov; }
-		void SetFOV(float fov)									{ this->fov = fov; }
+    /*! Задаёт файл тестового экрана (см. HmdRenderer::SetTestScreenFile) */
+    void SetTestScreenFile(const QString& fname, size_t width, size_t height) {
+      renderer_.SetTestScreenFile(fname, width, height);
+    }
 
-		int GetVideoAngle()										{ return video_angle; }
-		void SetVideoAngle(int angle)							{ this->video_angle = angle; }
+    /*! Задаёт прямоугольники наложения (меню, предупреждения и т.д.). Если
+    прямоугольников нет, проход наложения не выполняется */
+    void SetOverlay(const std::vector<OverlayQuad>& quads) { renderer_.SetOverlay(quads); }
 
-    void SetEyesDistance(float disp) { eyes_disp_ = disp; }
+    /*! Обновляет ячейки наложения. Остальные ячейки и прямоугольники
+    наложения не пересчитываются */
+    void UpdateOverlayCells(const std::vector<OverlayCell>& cells) { renderer_.UpdateOverlayCells(cells); }
 
-    void SetCylinderScreen(bool value);
+    void SetHorizontLevel(float horz) { renderer_.SetHorizontLevel(horz); }
 
-		VideoProjectionMode GetVideoProjectionMode()			{ return video_projection_mode; }
-		void SetVideoProjectionMode(VideoProjectionMode mode)	{ this->video_projection_mode = mode; }
+    /*! Включает измерение задержки: номер положения каждого кадра отмечается
+    в пробнике после чтения положения, отрисовки и вывода кадра */
+    void SetLatencyProbe(std::shared_ptr<LatencyProbe> probe) { latency_probe_ = probe; }
 
-		bool GetInvertStereo()									{ return invert_stereo; }
-		void SetInvertStereo(bool invert)						{ this->invert_stereo = invert; }
+    /*! Выдаёт скользящие процентили времени этапов отрисовки, по строке на этап */
+    std::string GetRenderStatistics() const { return renderer_.GetGpuTimer().Format(); }
 
-		void SetRGBWorkaround(bool enabled)						{ this->rgb_workaround = enabled; }
+    /*! Задаёт журнал кадров. Запись кадра выдаётся, когда готово время GPU,
+    через GpuTimer::kFramesInFlight кадров */
+    void SetFrameLog(std::shared_ptr<FrameLog> log) { frame_log_ = log; }
 
-    /*! Выдаёт указатель на данные для рисования окна информации.
-    Данные представляют собой массив kInfoHeight * kInfoWidth пикселей,
-    каждый пиксель 4 байта (RGBA) */
-    InfoTextureRow* GetInfoData() { return info_texture_array_; }
-    void ForceUpdateInfo() { force_update_info_ = true; }
+    /*! Задаёт экран времени кадров, в который передаются записи кадров.
+    Экран должен существовать всё время жизни виджета */
+    void SetFrameHud(FrameHud* hud) { frame_hud_ = hud; }
 
-    void SetHorizontLevel(float horz) { horizont_level_ = horz; }
+    /*! Задаёт пределы масштаба буфера глаз по каждой оси. Масштаб в пределах
+    выбирается по времени кадров на GPU (см. ResolutionGovernor). Равные
+    пределы задают постоянный масштаб */
+    void SetEyeScaleBounds(float min_scale, float max_scale);
 
 	protected:
 		void initializeGL() Q_DECL_OVERRIDE;
 		void resizeGL(int w, int h) Q_DECL_OVERRIDE;
 		void paintGL() Q_DECL_OVERRIDE;
 
- private:
-  static const size_t kTriangleFactor = 32;
-
-  std::vector<uint32_t> info_texture_data_; //!< Память под данные выделяются в конструкторе. Единожды
-  InfoTextureRow* info_texture_array_; //!< Указывает на данные в info_texture_data_
-  std::vector<QVector3D> cube_vertices_;
-
+ private slots:
+  void OnFrameSwapped();
 
-  // TODO Can make faster
-  std::atomic<float> eyes_disp_; //!< Смещение для компенсации меж-глазного расстояния
-  std::atomic<float> horizont_level_; //!< Смещение горизонта
-  std::atomic_bool force_update_info_; //!< Признак, что нужно принудительно обновить текстуру информации
-
-
-  void GenerateFlatVertices();
-  void AddFaceToVertices(QVector3D p1, QVector3D p2, QVector3D p3, QVector3D p4);
-
-  /*! Добавляет в cube_vertices_ два треугольника для представления квадрата с
-  вершинами p1-p2-p3-p4 */
-  void AddSquareToVertices(QVector3D p1, QVector3D p2, QVector3D p3, QVector3D p4);
-  QVector3D ApproximateVertice(QVector3D p1, QVector3D p2, QVector3D p3, QVector3D p4, float f1, float f2);
+ private:
+  HmdRenderer renderer_;
+  ResolutionGovernor governor_;
+
+  std::shared_ptr<LatencyProbe> latency_probe_;
+  uint64_t painted_sequence_; //!< Номер положения последнего отрисованного кадра
+  std::chrono::steady_clock::time_point paint_end_; //!< Конец отрисовки последнего кадра
+  std::shared_ptr<FrameLog> frame_log_;
+  FrameHud* frame_hud_;
+  FrameRecord frame_records_[GpuTimer::kFramesInFlight]; //!< Записи кадров, ждущие времени GPU
+  uint64_t frame_count_;
+  std::chrono::steady_clock::time_point first_paint_; //!< Начало отрисовки первого кадра
+  std::chrono::steady_clock::time_point last_paint_; //!< Начало отрисовки предыдущего кадра
+  uint64_t dropped_video_; //!< Пропущенные кадры видео на момент предыдущего кадра
+
+  /*! Дополняет запись кадра временем GPU, передаёт это время регулятору
+  масштаба буфера глаз и выдаёт запись в журнал и на экран времени кадров
+  \param gpu_ready время GPU кадра получено */
+  void CompleteFrameRecord(FrameRecord& record, bool gpu_ready);
 
 };
 
@@ -19,10 +19,14 @@
 #ifndef PSVR_HMDWINDOW_H
 #define PSVR_HMDWINDOW_H
 
+#include <chrono>
+
 #include <QMainWindow>
+#include <QTimer>
 
 #include "hmdwidget.h"
 
+#include "frame_hud.h"
 #include "info_screen.h"
 #include "mainwindow.h"
 
@@ -55,6 +59,9 @@ class HMDWindow : public QMainWindow
     void SetEyesDistance(float disp);
     void SetHorizontLevel(float horz);
 
+    /*! Показывает в шлеме экран времени кадров */
+    void ShowHud(bool show);
+
     // TODO Set private, fixes update
     uint64_t media_duration_; // in ms
     uint64_t current_play_position_; // in ms
@@ -65,6 +72,7 @@ class HMDWindow : public QMainWindow
   void OnLeft();
   void OnRight();
   void OnSelect();
+  void OnToggleHud();
 
 
 	protected:
@@ -75,19 +83,21 @@ class HMDWindow : public QMainWindow
   static const size_t kScrHeight = 1920;
   static const size_t kInfoScrXPos = 510;
   static const size_t kInfoScrYPos = 510;
+  static const size_t kHudXPos = 640; //!< Позиция экрана времени кадров, над экраном информации
+  static const size_t kHudYPos = 230;
   const uint64_t kBeforeEndInterval = 10000; //!< Minimal interval before end of movie after fastforward
   const uint64_t kForwardStep = 3000; //!< Интервал перемотки
+  const int kPlayTimeInterval = 100; //!< Интервал обновления времени проигрывания в шлеме, мс
+  const std::chrono::milliseconds kPlayTimeShowInterval{3000}; //!< Время показа времени проигрывания после перемотки
+  const int kHudInterval = 250; //!< Период обновления экрана времени кадров, мс
 
-  std::vector<uint32_t> test_scr_; //!< Загруженный тестовый экран. Может быть мустой массив, если тестовый экран не загружен
-  std::vector<uint32_t> compose_scr_; //!< Память для объединения тестового экрана и меню
-
-  HMDWidget::InfoTextureRow* info_data_;
   InformationScreen info_scr_;
+  FrameHud hud_; //!< Экран времени кадров. Ячейки наложения идут после ячеек экрана информации
+  QTimer hud_timer_;
   PsvrControl* psvr_control_;
   bool show_menu_; //!< Признак, что отображается настроечное меню
-
-  /*! Загрузить тестовую информацию, если она есть */
-  void LoadTestInfo();
+  QTimer play_time_timer_;
+  std::chrono::steady_clock::time_point play_time_hide_; //!< Момент, когда нужно скрыть время проигрывания (если меню не показано)
 
   void ShowMenu();
   void UpdateInformation();
@@ -101,6 +111,16 @@ class HMDWindow : public QMainWindow
  private slots:
   void PlayerPlaying();
 
+  /*! Показывает предупреждение, если шлем не переключился в VR режим */
+  void OnVRModeSet(bool success);
+
+  /*! Обновляет время и прогресс проигрывания в шлеме. Обновляются только
+  изменившиеся символы */
+  void UpdatePlayTime();
+
+  /*! Завершает период экрана времени кадров и выводит изменившиеся ячейки */
+  void UpdateHud();
+
 };
 
 
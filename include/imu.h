@@ -0,0 +1,148 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef IMU_PSVR_PLAYER_03072024
+#define IMU_PSVR_PLAYER_03072024
+
+#include <cstddef>
+#include <cstdint>
+
+/*! One sample of the helmet IMU. Axes are named as in docs/Coordinates.txt */
+struct ImuSample {
+  uint32_t tick; //!< Device timestamp in microseconds. Wraps around
+  int16_t gyro_yaw; //!< Turn around y axis
+  int16_t gyro_pitch; //!< Turn around x axis
+  int16_t gyro_roll; //!< Turn around z axis
+  int16_t accel[3]; //!< Raw accelerometer values
+};
+
+/*! Unit quaternion of the helmet orientation. Vector part is in terms of
+angles of docs/Coordinates.txt: rotation by small angles (x, y, z) has vector
+(x, y, z) / 2 */
+struct ImuQuaternion {
+  double w;
+  double x;
+  double y;
+  double z;
+};
+
+const ImuQuaternion kIdentityQuaternion = {1.0, 0.0, 0.0, 0.0};
+
+const size_t kImuSamplesPerReport = 2;
+const double kGyroCoef = 0.0000625; //!< Angle speed of one gyro unit, degrees per millisecond
+const double kMaxGyroBiasUnits = 8.0; //!< Largest plausible gyro bias per axis, gyro units (0.5 degree per second)
+const uint32_t kMaxSampleIntervalUs = 50000; //!< Longer interval between samples is a gap in data, it isn't integrated
+const double kAccelOneG = 16384.0; //!< Accelerometer value of gravity
+
+/*! Parses sensor report into IMU samples.
+\param data, size report
+\param samples array of kImuSamplesPerReport samples
+\return number of parsed samples. 0 if the report has wrong size */
+size_t ParseSensorReport(const unsigned char* data, size_t size, ImuSample* samples);
+
+/*! Returns q1 * q2 (rotation q2 is applied first) */
+ImuQuaternion MultiplyQuaternions(const ImuQuaternion& q1, const ImuQuaternion& q2);
+
+/*! Limits measured bias compensation speed (degrees per ms) to the plausible
+gyro bias, so a wrong value isn't learned */
+double ClampGyroBias(double velocity);
+
+/*! Rotates vector v by unit quaternion q */
+void RotateVector(const ImuQuaternion& q, const double v[3], double result[3]);
+
+/*! Returns rotation vector of the orientation: axis multiplied by angle in degrees.
+For rotation around one axis it's the angle around this axis */
+void GetRotationAngles(const ImuQuaternion& q, double angles[3]);
+
+/*! Calculates angle speed of the sample.
+\param velo compensation angle speeds around x, y, z (degrees per ms)
+\param result angle speeds around x, y, z (degrees per ms) */
+void GetAngularVelocity(const ImuSample& sample, const double velo[3], double result[3]);
+
+/*! Integrates rotation sample by sample. Interval of every sample is taken from
+device timestamps, so reading jitter doesn't affect the result.
+Tilt (rotation around x and z) is corrected by gravity direction from the
+accelerometer with Mahony filter. Yaw has no gravity reference and is
+integrated by gyro only */
+class ImuIntegrator {
+ public:
+  ImuIntegrator();
+
+  /*! Forgets the previous sample. The next sample starts integration */
+  void Reset();
+
+  /*! Takes gravity direction of the next still sample as the reference for
+  tilt correction. Called on view resetting, so the reset tilt is kept */
+  void ResetReference();
+
+  /*! Enables tilt correction by accelerometer. Estimated bias is cleared */
+  void SetTiltCorrection(bool enabled);
+
+  /*! Rotates the orientation by the sample. Rotation of one sample is small, so
+  it's applied as a small-angle quaternion without trigonometry
+  \param sample IMU sample
+  \param velo compensation angle speeds around x, y, z (degrees per ms)
+  \param orientation unit quaternion of the orientation
+  \return interval of the sample in ms. 0 if the sample isn't integrated (first
+  sample or gap in data) */
+  double Integrate(const ImuSample& sample, const double velo[3], ImuQuaternion& orientation);
+
+ private:
+  const double kAccelTolerance = 0.1; //!< Acceleration differing from gravity more than by this part isn't used for correction
+  const double kTiltKp = 0.0005; //!< Proportional gain of tilt correction, 1/ms
+  const double kTiltKi = 0.0000002; //!< Integral gain of tilt correction, 1/ms^2
+
+  bool has_tick_;
+  uint32_t last_tick_;
+  bool tilt_correction_;
+  bool reference_pending_;
+  double reference_gravity_[3]; //!< Accelerometer direction relatively to the user. Angle axes are the helmet axes turned around z by 180 degrees, so it's (0, -1, 0) for level helmet
+  double bias_[3]; //!< Estimated gyro bias, radians per ms
+
+  /*! Adds correction of orientation by gravity to the angle speed (degrees per ms) */
+  void CorrectTilt(const ImuSample& sample, const ImuQuaternion& orientation, double ims, double speed[3]);
+};
+
+/*! Detects the helmet lying still (e.g. on the table) by variance of gyro and
+accelerometer values in windows of samples. Mean gyro values of a still window
+are the gyro bias. A slow steady turn has low variance too, so a window with
+mean gyro above kMaxGyroBiasUnits on any axis isn't still */
+class StillnessDetector {
+ public:
+  StillnessDetector();
+
+  /*! Adds the sample to the window.
+  \param bias measured bias as compensation angle speeds around x, y, z
+  (degrees per ms). Filled when true is returned
+  \return the window is complete and the helmet was still during it */
+  bool AddSample(const ImuSample& sample, double bias[3]);
+
+ private:
+  static const size_t kChannels = 6; //!< gyro yaw, pitch, roll, accelerometer 0, 1, 2
+  const size_t kWindowSamples = 2000; //!< About 1 second
+  const double kStillGyroVariance = 9.0; //!< Noise of still gyro, squared units
+  const double kStillAccelVariance = 10000.0; //!< Noise of still accelerometer, squared units (0.006 g)
+
+  size_t count_;
+  double sum_[kChannels];
+  double square_sum_[kChannels];
+
+  void Clear();
+};
+
+#endif
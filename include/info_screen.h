@@ -7,7 +7,9 @@
 #include <string>
 #include <vector>
 
-#include "tile.h"
+#include "osd_text.h"
+#include "overlay.h"
+#include "sprite_atlas.h"
 
 struct InformationState {
 
@@ -28,7 +30,34 @@ class InformationScreen {
     kRePositionAction, // Сменить позицию проигрывания
   };
 
-  const std::vector<uint32_t>& GetInfoScr();
+  /*! Добавляет в quads прямоугольники, из которых состоит экран информации.
+  Прямоугольники ссылаются на атлас GetAtlas().
+  \param xpos, ypos позиция экрана информации на поле наложения */
+  void GetQuads(std::vector<OverlayQuad>& quads, size_t xpos, size_t ypos);
+
+  /*! Атлас с картинками экрана информации */
+  const OverlayAtlas& GetAtlas() const { return atlas_; }
+
+  /*! Атлас символов экранного текста */
+  OverlayAtlas GetGlyphAtlas() const { return glyphs_.GetAtlas(); }
+
+  /*! Символы экранного текста, для другого текста в том же атласе */
+  const GlyphAtlas& GetGlyphs() const { return glyphs_; }
+
+  /*! Количество ячеек наложения, занятых экраном информации */
+  static size_t GetCellCount() { return kPlayTimeLength + kProgressSegments * 2; }
+
+  /*! Задаёт время проигрывания для экранного отображения.
+  \param text строка времени (текущее время и длительность)
+  \param progress доля просмотренного, от 0 до 1 */
+  void SetPlayTime(const std::string& text, float progress);
+  void ShowPlayTime(bool show);
+
+  /*! Добавляет в cells ячейки экранного текста, изменившиеся с прошлого
+  вызова.
+  \param xpos, ypos позиция экрана информации на поле наложения */
+  void TakeChangedCells(std::vector<OverlayCell>& cells, size_t xpos, size_t ypos);
+
   size_t GetInfoScrWidth() const { return kScrWidth; }
   size_t GetInfoScrHeight() const { return kScrHeight; }
 
@@ -50,46 +79,49 @@ class InformationScreen {
   InformationScreen(InformationScreen&&) = delete;
   InformationScreen& operator=(InformationScreen&&) = delete;
 
-  using Image = std::vector<uint32_t>;
+  using SpriteId = sprite_atlas::SpriteId;
 
   enum MenuPosition {
     kMenuInvert,
     kMenuPlay
   };
 
+  /*! Размещение картинки на экране */
+  struct Placement {
+    SpriteId sprite;
+    size_t x;
+    size_t y;
+
+    bool operator==(const Placement& other) const {
+      return sprite == other.sprite && x == other.x && y == other.y;
+    }
+  };
+
   const size_t kScrWidth = 900;
   const size_t kScrHeight = 900;
   static const size_t kTileWidth = 80;
   static const size_t kTileHeight = 80;
   static const size_t kWarningWidth = 160;
   static const size_t kWarningHeight = 160;
-  const size_t kTileSize = kTileWidth * kTileHeight;
-  const size_t kWarningSize = kWarningWidth * kWarningHeight;
-
-  Image info_scr_;
+  static const int kGlyphSize = 32; //!< Высота шрифта экранного текста в пикселях
+  static const size_t kPlayTimeLength = 23; //!< Длина строки времени "00:00:00.0 / 00:00:00.0"
+  static const size_t kProgressSegments = 10;
+  static const size_t kProgressHeight = 10;
+
+  OverlayAtlas atlas_;
+  GlyphAtlas glyphs_;
+  OsdText play_time_; //!< Время проигрывания
+  OsdProgressBar progress_; //!< Полоса прогресса проигрывания
+  std::vector<Placement> layout_; //!< Картинки, из которых состоит текущий экран (в порядке отрисовки)
   MenuPosition active_pos_; //!< Текущая выделенная (вертикальная) позиция в списке меню
   int active_selection_; //!< Текущий выделенный (горизонтальный) пункт в меню
-  Image invert_0_tile_;
-  Image invert_1_tile_;
-  Image play_tile_;
-  Image fast_backward_tile_;
-  Image backward_tile_;
-  Image forward_tile_;
-  Image fast_forward_tile_;
-
-  Image selector_tile_;
-  Image no_vr_tile_;
-
   std::atomic_bool screen_changed_;
   bool no_vr_;
   bool show_menu_;
 
   int setting_invert_;
 
-  void LoadResources();
-
-  void LoadResFile(std::vector<uint32_t>& storage, std::string fname, size_t req_size);
-  void Tile(const Image& img, size_t x, size_t y, size_t width = kTileWidth);
+  void Tile(SpriteId sprite, size_t x, size_t y);
   void DrawScreen();
   void DrawInvertMenu(MenuPosition pos, int sel);
   void DrawPlayMenu(MenuPosition pos, int sel);
@@ -35,6 +35,7 @@ class KeyFilter: public QObject {
    void ResetView();
    void FullScreen();
    void CompensateView();
+   void ToggleHud();
 
    void Up();
    void Down();
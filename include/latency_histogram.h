@@ -0,0 +1,88 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LATENCY_HISTOGRAM_PSVR_PLAYER_05072024
+#define LATENCY_HISTOGRAM_PSVR_PLAYER_05072024
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*! Histogram of durations in microseconds with logarithmic buckets: every
+power of two is divided into 16 buckets, so precision is about 6%. Record can
+be called from any thread without locks, reading gives consistent enough
+values for diagnostics */
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  void Record(uint64_t value_us);
+
+  uint64_t GetCount() const;
+  uint64_t GetMax() const;
+
+  /*! Returns upper bound of the bucket containing the percentile
+  \param percentile value from 0 to 100 */
+  uint64_t GetPercentile(double percentile) const;
+
+  /*! Formats as "count, p50, p99, max" */
+  std::string Format() const;
+
+ private:
+  static const size_t kSubBits = 4;
+  static const size_t kSubBuckets = 1 << kSubBits;
+  static const size_t kBucketCount = kSubBuckets * (64 - kSubBits + 1);
+
+  std::atomic<uint64_t> buckets_[kBucketCount];
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> max_;
+
+  static size_t GetBucket(uint64_t value);
+  static uint64_t GetBucketTop(size_t bucket);
+};
+
+/*! Last values of a duration (microseconds) for rolling percentiles. Isn't
+thread-safe: used by one thread, e.g. the rendering one */
+class RollingPercentiles {
+ public:
+  /*! \param window number of kept values */
+  explicit RollingPercentiles(size_t window = 256);
+
+  void Record(uint64_t value_us);
+
+  size_t GetCount() const { return values_.size(); }
+
+  /*! Returns the last value or 0 if there are no values */
+  uint64_t GetLast() const;
+
+  /*! Returns exact percentile of kept values
+  \param percentile value from 0 to 100 */
+  uint64_t GetPercentile(double percentile) const;
+
+  /*! Formats as "p50, p95, max" of kept values */
+  std::string Format() const;
+
+ private:
+  size_t window_;
+  size_t next_; //!< Position of the next value when the window is full
+  std::vector<uint64_t> values_;
+};
+
+#endif
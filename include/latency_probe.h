@@ -0,0 +1,86 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LATENCY_PROBE_PSVR_PLAYER_06072024
+#define LATENCY_PROBE_PSVR_PLAYER_06072024
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "latency_histogram.h"
+#include "sensor_device.h"
+
+/*! Stages of the pipeline passed by the step of angle speed */
+enum LatencyStage {
+  kLatencyPublish, //!< The pose with the step is published by the sensors reader
+  kLatencyPoseRead, //!< The renderer takes the pose for a frame
+  kLatencyRender, //!< Both eyes are rendered
+  kLatencySwap, //!< The frame is swapped to the screen
+  kLatencyStageCount
+};
+
+/*! Measures motion-to-photon latency. The simulated device injects a step of
+angle speed, the pose carrying the step is tagged by its sequence number and
+the number is tracked through rendering. Latency of every stage is measured
+from arrival of the report with the step. One step is measured at once.
+Methods are thread-safe */
+class LatencyProbe {
+ public:
+  LatencyProbe();
+
+  /*! Starts measurement of the step. Unfinished measurement is dropped
+  \param tick device timestamp of the first sample with the step
+  \param time arrival of the report with the step */
+  void Inject(uint32_t tick, std::chrono::steady_clock::time_point time);
+
+  /*! Tags the pose if it's the first one integrated with the step
+  \param tick device timestamp of the last integrated sample
+  \param sequence sequence number of the published pose */
+  void Publish(uint32_t tick, uint64_t sequence);
+
+  /*! Marks the stage for the pose. Stages of older poses are ignored */
+  void Reach(LatencyStage stage, uint64_t sequence);
+
+  /*! Number of steps passed through all stages */
+  uint64_t GetCount() const;
+
+  /*! Formats latency of all stages and count of dropped steps */
+  std::string Format() const;
+
+ private:
+  mutable std::mutex lock_;
+  bool injected_;
+  bool tagged_;
+  uint32_t tick_;
+  std::chrono::steady_clock::time_point time_;
+  uint64_t sequence_;
+  int reached_; //!< Next stage to reach
+  uint64_t dropped_;
+  LatencyHistogram stages_[kLatencyStageCount];
+
+  void Record(LatencyStage stage);
+};
+
+/*! Opens simulated helmet: level and still except regular steps of yaw speed.
+Every step is injected into the probe */
+std::unique_ptr<SensorDevice> OpenStepSensorDevice(std::shared_ptr<LatencyProbe> probe);
+
+#endif
@@ -23,6 +23,7 @@
 #include <QSettings>
 #include <QTimer>
 
+#include "device_manager.h"
 #include "key_filter.h"
 #include "videoplayer.h"
 #include "psvr.h"
@@ -59,6 +60,9 @@ class MainWindow : public QMainWindow
 
 		void SetHMDWindow(HMDWindow *hmd_window);
 
+    /*! Форматирует время проигрывания как чч:мм:сс.д */
+    static QString FormatPlayTime(uint64_t value_ms);
+
 	protected slots:
 		void PSVRUpdate();
 		void FOVValueChanged(double v);
@@ -93,6 +97,10 @@ class MainWindow : public QMainWindow
 		void closeEvent(QCloseEvent *event) Q_DECL_OVERRIDE;
 
  private slots:
+  void OnHelmetChanged();
+  void OnSensorsOpened(bool opened);
+  void OnSensorsFailed();
+  void ReopenSensors();
   void OnEyesCorrChanged(int);
   void OnAutoFullScreenChanged(int);
   void OnHorizontChanged(int);
@@ -100,7 +108,8 @@ class MainWindow : public QMainWindow
 
 
  private:
-  const int kUpdateSensorsInterval = 2000;
+  const int kUpdateSensorsInterval = 2000; //!< Интервал обновления состояния шлема и статистики в окне
+  const int kReopenSensorsDelay = 1000; //!< Задержка повторного открытия сенсоров после сбоя чтения. Подключение шлема отслеживает device_manager_
   const uint64_t kBeforeEndInterval = 10000; //!< Minimal interval before end of movie after fastforward
   const float kEyeCorrFactor = -0.015f;
   const float kHorizontCorrFactor = 0.05;
@@ -116,14 +125,23 @@ class MainWindow : public QMainWindow
   bool auto_full_screen_;
   int horizont_level_;
   float fov_; //! Угол обзора
+  QString helmet_serial_; //!< Серийный номер шлема, для которого загружена компенсация
 
-  QString FormatPlayTime(uint64_t value_ms);
   void ShowHelmetState();
 
+  /*! Загружает компенсацию скорости поворота для открытого шлема. Компенсация
+  предыдущего шлема сохраняется */
+  void LoadHelmetVelocity();
+
+  /*! Сохраняет компенсацию скорости поворота текущего шлема */
+  void SaveHelmetVelocity();
+
   void UpdateFov();
 
 
   QTimer update_timer_;
+  DeviceManager device_manager_;
+  HelmetInterfaces opened_interfaces_; //!< Интерфейсы, открытие которых запрошено
 };
 
 
@@ -0,0 +1,169 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef OSD_TEXT_PSVR_PLAYER_19062024
+#define OSD_TEXT_PSVR_PLAYER_19062024
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "overlay.h"
+
+/*! Атлас символов для экранного текста (OSD). Символы моноширинные, все
+ячейки одного размера. Атлас растеризуется один раз при создании */
+class GlyphAtlas {
+ public:
+  static const char kFillGlyph = '\x7f'; //!< Непрозрачный белый прямоугольник (заполнение полос)
+  static const char kShadeGlyph = '\x01'; //!< Полупрозрачный тёмный прямоугольник (фон полос)
+
+  /*! Растеризует печатные символы ASCII и служебные прямоугольники
+  \param pixel_size высота шрифта в пикселях */
+  explicit GlyphAtlas(int pixel_size);
+
+  /*! Атлас символов. Пиксели rgba с предумноженной прозрачностью */
+  OverlayAtlas GetAtlas() const;
+
+  size_t GetCellWidth() const { return cell_width_; }
+  size_t GetCellHeight() const { return cell_height_; }
+
+  /*! Область символа в атласе. Для отсутствующих символов выдаётся пробел */
+  const TileRect& GetGlyphRect(char ch) const;
+
+ private:
+  GlyphAtlas(const GlyphAtlas&) = delete;
+  GlyphAtlas& operator=(const GlyphAtlas&) = delete;
+
+  static const char kFirstGlyph = '\x01';
+  static const char kLastGlyph = '\x7f';
+  static const size_t kColumns = 16;
+  static const size_t kPadding = 2; //!< Прозрачный зазор между символами
+
+  size_t cell_width_;
+  size_t cell_height_;
+  size_t width_;
+  size_t height_;
+  std::vector<uint32_t> pixels_;
+  std::vector<TileRect> rects_; //!< Области символов от kFirstGlyph до kLastGlyph
+};
+
+
+/*! Строка экранного текста фиксированной длины. Каждый символ занимает свою
+ячейку наложения (OverlayCell), при изменении текста выдаются только
+изменившиеся ячейки */
+class OsdText {
+ public:
+  /*! \param glyphs атлас символов. Должен существовать всё время жизни строки
+  \param first_cell номер первой ячейки наложения строки
+  \param length длина строки в символах (количество ячеек)
+  \param x, y позиция строки на экране информации */
+  OsdText(const GlyphAtlas& glyphs, size_t first_cell, size_t length, size_t x, size_t y);
+
+  /*! Задаёт текст. Лишние символы отбрасываются, недостающие заменяются
+  пробелами */
+  void SetText(const std::string& text);
+  void SetVisible(bool visible);
+
+  /*! Добавляет в cells изменившиеся с прошлого вызова ячейки
+  \param xpos, ypos позиция экрана информации на поле наложения */
+  void TakeChangedCells(std::vector<OverlayCell>& cells, size_t xpos, size_t ypos);
+
+ private:
+  const GlyphAtlas& glyphs_;
+  size_t first_cell_;
+  size_t x_;
+  size_t y_;
+  std::string text_; //!< Текущий текст, дополненный пробелами до длины строки
+  std::vector<bool> changed_; //!< Признак изменения для каждой ячейки
+  bool visible_;
+};
+
+
+/*! Полоса прогресса из ячеек наложения: под каждым сегментом лежит тёмный
+фон, сверху - белое заполнение. Выдаются только изменившиеся сегменты */
+class OsdProgressBar {
+ public:
+  /*! \param glyphs атлас символов (берутся служебные прямоугольники)
+  \param first_cell номер первой ячейки наложения. Полоса занимает
+  segments * 2 ячеек
+  \param segments количество сегментов
+  \param x, y, width, height область полосы на экране информации */
+  OsdProgressBar(const GlyphAtlas& glyphs, size_t first_cell, size_t segments,
+      size_t x, size_t y, size_t width, size_t height);
+
+  /*! Задаёт прогресс от 0 до 1 */
+  void SetProgress(float progress);
+  void SetVisible(bool visible);
+
+  /*! Добавляет в cells изменившиеся с прошлого вызова ячейки
+  \param xpos, ypos позиция экрана информации на поле наложения */
+  void TakeChangedCells(std::vector<OverlayCell>& cells, size_t xpos, size_t ypos);
+
+ private:
+  const GlyphAtlas& glyphs_;
+  size_t first_cell_;
+  size_t x_;
+  size_t y_;
+  size_t width_;
+  size_t height_;
+  std::vector<size_t> fill_; //!< Заполненная ширина каждого сегмента в пикселях
+  std::vector<bool> changed_;
+  bool visible_;
+
+  size_t GetSegmentX(size_t index) const;
+  size_t GetSegmentWidth(size_t index) const;
+};
+
+
+/*! График из ячеек наложения: столбцы с тёмным фоном и белым заполнением
+снизу. Новое значение добавляется справа, старые сдвигаются влево. Выдаются
+только изменившиеся ячейки */
+class OsdGraph {
+ public:
+  /*! \param glyphs атлас символов (берутся служебные прямоугольники)
+  \param first_cell номер первой ячейки наложения. График занимает
+  columns * 2 ячеек
+  \param columns количество столбцов
+  \param x, y, width, height область графика на экране информации */
+  OsdGraph(const GlyphAtlas& glyphs, size_t first_cell, size_t columns,
+      size_t x, size_t y, size_t width, size_t height);
+
+  /*! Добавляет столбец со значением от 0 до 1 (доля высоты графика) */
+  void AddValue(float value);
+  void SetVisible(bool visible);
+
+  /*! Добавляет в cells изменившиеся с прошлого вызова ячейки
+  \param xpos, ypos позиция экрана информации на поле наложения */
+  void TakeChangedCells(std::vector<OverlayCell>& cells, size_t xpos, size_t ypos);
+
+ private:
+  static const size_t kColumnGap = 2; //!< Зазор между столбцами в пикселях
+
+  const GlyphAtlas& glyphs_;
+  size_t first_cell_;
+  size_t x_;
+  size_t y_;
+  size_t width_;
+  size_t height_;
+  std::vector<size_t> fill_; //!< Заполненная высота каждого столбца в пикселях
+  std::vector<bool> changed_;
+  bool visible_;
+};
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef OVERLAY_PSVR_PLAYER_12062024
+#define OVERLAY_PSVR_PLAYER_12062024
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tile.h"
+
+/*! Размер поля наложения (информации) в пикселях. Поле занимает область
+экрана -1 - +1 по обеим осям */
+const size_t kOverlayWidth = 1920;
+const size_t kOverlayHeight = 1920;
+
+/*! Текстура, из которой берётся изображение прямоугольника наложения */
+enum OverlayTexture {
+  kTestScreenTexture, //!< Тестовый экран (рисуется первым, под остальными)
+  kSpriteAtlasTexture, //!< Атлас картинок меню
+  kGlyphAtlasTexture, //!< Атлас символов экранного текста
+  kOverlayTextureCount
+};
+
+/*! Прямоугольник наложения. Координаты x, y, width, height задаются в
+пикселях поля наложения (x слева направо, y сверху вниз), координаты
+u, v, tex_width, tex_height - в пикселях текстуры texture */
+struct OverlayQuad {
+  OverlayTexture texture;
+  float x;
+  float y;
+  float width;
+  float height;
+  float u;
+  float v;
+  float tex_width;
+  float tex_height;
+};
+
+/*! Ячейка наложения: прямоугольник с постоянным местом в буфере вершин.
+Ячейки обновляются по отдельности, без пересчёта остального наложения.
+Изображение ячеек берётся из атласа символов. Ячейка нулевой ширины скрыта */
+struct OverlayCell {
+  size_t index; //!< Номер ячейки от 0 до kOverlayCellCount - 1
+  OverlayQuad quad;
+};
+
+const size_t kOverlayCellCount = 256;
+
+/*! Атлас картинок: все картинки в одном изображении. Пиксели rgba с
+предумноженной прозрачностью. Данные атласа не копируются: pixels указывает на
+массив, встроенный в программу при сборке */
+struct OverlayAtlas {
+  size_t width;
+  size_t height;
+  const uint32_t* pixels;
+};
+
+/*! Собирает атлас из картинок images. Используется при сборке программы
+генератором атласа (tools/sprite_atlas_gen.cpp).
+\param pixels пиксели собранного атласа
+\param width, height размер собранного атласа
+\param images картинки для размещения
+\param rects область каждой картинки в атласе (в порядке images) */
+void BuildOverlayAtlas(std::vector<uint32_t>& pixels, size_t& width, size_t& height,
+    const std::vector<const TileImage*>& images, std::vector<TileRect>& rects);
+
+#endif
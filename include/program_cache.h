@@ -0,0 +1,63 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef PROGRAM_CACHE_PSVR_PLAYER_09072024
+#define PROGRAM_CACHE_PSVR_PLAYER_09072024
+
+#include <QByteArray>
+#include <QOpenGLShaderProgram>
+#include <QString>
+
+/*! Дисковый кэш собранных программ шейдеров (glGetProgramBinary /
+glProgramBinary). Файлы лежат в подкаталоге драйвера: его имя - хэш
+производителя, рендерера и версии OpenGL. Хранятся подкаталоги нескольких
+последних использованных драйверов, более старые удаляются. Имя файла - хэш ключа программы (исходные тексты
+с макросами и атрибуты). Используется в потоке OpenGL при текущем контексте */
+class ProgramBinaryCache {
+ public:
+  /*! \param directory каталог кэша. Пустой выключает кэш */
+  explicit ProgramBinaryCache(const QString& directory);
+
+  /*! Загружает программу из кэша.
+  \param program созданная программа без шейдеров
+  \param key ключ программы
+  \return программа загружена и собрана. Иначе в программу можно добавить
+  шейдеры и собрать её обычным образом */
+  bool Load(QOpenGLShaderProgram* program, const QByteArray& key);
+
+  /*! Разрешает получить собранную программу. Вызывается перед сборкой */
+  void PrepareLink(QOpenGLShaderProgram* program);
+
+  /*! Сохраняет собранную программу в кэш */
+  void Save(QOpenGLShaderProgram* program, const QByteArray& key);
+
+ private:
+  static const char kSignature[]; //!< Начало файла кэша
+
+  QString directory_;
+  bool initialized_;
+  bool enabled_;
+  QString driver_directory_;
+
+  /*! Проверяет поддержку двоичных программ драйвером и готовит каталог */
+  bool Init();
+
+  QString GetFileName(const QByteArray& key) const;
+};
+
+#endif
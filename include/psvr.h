@@ -19,22 +19,41 @@
 #ifndef PSVR_PSVR_H
 #define PSVR_PSVR_H
 
+#include <atomic>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
+#include <string>
 #include <thread>
+#include <vector>
 
 #include <hidapi/hidapi.h>
 #include <QMatrix4x4>
 
-#define PSVR_BUFFER_SIZE 64
+#include "coalescing_notifier.h"
+#include "imu.h"
+#include "latency_histogram.h"
+#include "latency_probe.h"
+#include "sensor_device.h"
+#include "seq_lock.h"
+#include "session_record.h"
+
+/*! Snapshot of the helmet state for rendering of one frame */
+struct HelmetPose {
+  QMatrix4x4 model_view; //!< Matrix of the orientation
+  ImuQuaternion orientation;
+  double velocity[3]; //!< Angle speed around x, y, z (degrees per ms)
+  std::chrono::steady_clock::time_point time; //!< Arrival of the last integrated report
+  std::chrono::steady_clock::time_point publish_time; //!< Publishing of the pose
+  uint64_t sequence; //!< Number of the published pose
+};
 
 class PsvrSensors: public QObject
 {
   Q_OBJECT
 
 	private:
-    hid_device* device_;
-
-		unsigned char buffer[PSVR_BUFFER_SIZE];
+    std::unique_ptr<SensorDevice> device_;
 
 	public:
     PsvrSensors();
@@ -43,28 +62,78 @@ class PsvrSensors: public QObject
 		static hid_device_info *EnumerateDevices();
 
     bool OpenDevice();
+
+    /*! Opens the sensor interface found by enumeration
+    \param hid_path hidapi path of the interface
+    \param serial serial number of the helmet */
+    bool OpenDevice(const std::string& hid_path, const std::string& serial);
     void CloseDevice();
 
-    bool IsOpen()					{ return device_ != 0; }
+    /*! Queues opening of the sensor interface. It's opened by the opening
+    thread, so the caller isn't blocked. The result comes as DeviceOpened
+    signal. Only the last queued request is executed */
+    void RequestOpen(const std::string& hid_path, const std::string& serial);
+
+    /*! Queues closing of the device on the opening thread */
+    void RequestClose();
+
+    /*! Device is opened and reading is working */
+    bool IsOpen()					{ return device_opened_ && !device_failed_; }
 
-		bool Read(int timeout);
+    /*! Sets SCHED_FIFO priority of the reading thread (1-99). 0 means default
+    scheduling. Applied on next OpenDevice */
+    void SetReaderPriority(int priority) { reader_priority_ = priority; }
+
+    /*! Sets session mode: reports are written into the recorder (if any) and
+    are read from replay_file instead of the helmet (if it isn't empty).
+    Applied on next OpenDevice */
+    void SetSession(std::shared_ptr<SessionRecorder> recorder, const std::string& replay_file, bool replay_fast);
+
+    /*! Switches to measurement of motion-to-photon latency: reports come from
+    simulated helmet with steps of angle speed, published poses are tagged in
+    the probe. Applied on next OpenDevice */
+    void SetLatencyProbe(std::shared_ptr<LatencyProbe> probe) { latency_probe_ = probe; }
+
+    /*! Reports are replayed from the session file or simulated: there is no hardware */
+    bool IsVirtual() const { return !replay_file_.empty() || latency_probe_; }
 
     void ResetView(bool apply_compensation);
 
-    /*! Выдаёт матрицу разворота */
-    void GetModelViewMatrix(QMatrix4x4& matrix);
+    /*! Выдаёт последнее положение шлема. Не блокируется чтением сенсоров,
+    поэтому вызывается из потока отрисовки один раз на кадр. Возраст положения
+    попадает в статистику */
+    void GetPose(HelmetPose& pose);
+
+    /*! Выдаёт количество чтений положения и повторов чтения из-за его
+    одновременного обновления */
+    void GetPoseStatistics(uint64_t& loads, uint64_t& retries) const { pose_.GetStatistics(loads, retries); }
+
+    /*! Выдаёт статистику конвейера сенсоров: интервалы отчётов, задержку от
+    чтения до публикации положения, возраст положения при отрисовке, короткие
+    отчёты и обрывы чтения. Несколько строк, для окна и для лога */
+    std::string FormatStatistics() const;
 
     /*! Выставляет сохранённые значения скорости шлема */
     void SetVelocity(double xvelocity, double yvelocity, double zvelocity);
 
     void GetVelocity(double& xvelocity, double& yvelocity, double& zvelocity);
 
+    /*! Выдаёт серийный номер шлема, найденного при последнем открытии.
+    Пустая строка, если номер неизвестен */
+    std::string GetSerial() const;
+
  signals:
   void SensorUpdate();
 
+  /*! Opening queued by RequestOpen is finished. The parameter is success.
+  Emitted from the opening thread */
+  void DeviceOpened(bool);
+
+  /*! Reading is stopped by device error. Emitted from the reader thread */
+  void DeviceFailed();
+
  private:
-  const int kReadIntervalMcs = 500;
-  const int kReadTimeoutMs = 1; //!< Timeout for reading sensors from hid device. Using "-1" can cause hangup.
+  const int kReadTimeoutMs = 100; //!< Timeout for waiting sensor reports. The reader checks stop flag after it. Using "-1" can cause hangup.
   const int kMinimumCompensationIntervalMs = 5000; //!< Minimal time for applying compensation algorithm
   const unsigned short kPsvrVendorID = 0x054c;
   const unsigned short kPsvrProductID = 0x09af;
@@ -72,7 +141,8 @@ class PsvrSensors: public QObject
 
   // Compensation
   const double kCompensationRough = 0.3;
-  std::chrono::steady_clock::time_point last_reading_; //!< time of last read/rotate operation. Or default value if not valid. Changed in PsvrSensors::Read only.
+  const double kBiasUpdateRate = 0.2; //!< Part of the difference to measured bias applied per still window
+  std::chrono::steady_clock::time_point last_reading_; //!< time of last read/rotate operation. Or default value if not valid. Changed in PsvrSensors::ProcessReports only.
   std::chrono::steady_clock::time_point last_reset_view_;
 
   // Current angle speed (degrees per milliseconds) for axis compensation
@@ -80,20 +150,67 @@ class PsvrSensors: public QObject
   double y_velo_;
   double z_velo_;
 
-  // Текущие углы поворота шлема относительно пользователя
-  // Т.е. если польователь повернул голову направо, то y_angle будет положительный.
-  // Подробнее про систему координат написано в docs/Координаты.txt
-  double x_angle_;
-  double y_angle_;
-  double z_angle_;
+  // Текущий поворот шлема относительно пользователя
+  // Т.е. если польователь повернул голову направо, то поворот вокруг y будет положительный.
+  // Подробнее про систему координат написано в docs/Coordinates.txt
+  ImuQuaternion orientation_;
+  double angular_velocity_[3];
+
+  SeqLock<HelmetPose> pose_; //!< Published state. Written under angle_lock_, read without locks
 
-  std::mutex angle_lock_;
+  ImuIntegrator integrator_; //!< Used under angle_lock_
+  StillnessDetector still_detector_; //!< Updates angle speed compensation while the helmet lies still. Used by the reader thread only
+  std::mutex angle_lock_; //!< Serializes writers of the state: the reader thread and view resetting
 
+  std::mutex device_lock_; //!< Serializes opening and closing of the device
   std::thread read_thr_;
   std::atomic_bool run_reading_;
+  std::atomic_bool device_opened_;
+  std::atomic_bool device_failed_; //!< Reading is stopped by device error (e.g. helmet is switched off)
+  std::atomic_int reader_priority_;
+  mutable std::mutex serial_lock_;
+  std::string serial_;
+
+  // Requests of RequestOpen and RequestClose. Used under open_lock_
+  std::mutex open_lock_;
+  std::condition_variable open_cv_;
+  bool open_pending_; //!< There is a request
+  bool open_requested_; //!< The request is opening, otherwise closing
+  std::string open_path_;
+  std::string open_serial_;
+  bool open_stop_;
+  std::thread open_thr_;
+  std::shared_ptr<SessionRecorder> recorder_;
+  std::string replay_file_;
+  bool replay_fast_;
+  std::shared_ptr<LatencyProbe> latency_probe_;
+  uint64_t pose_sequence_; //!< Number of the last published pose. Used under angle_lock_
+  CoalescingNotifier update_notifier_; //!< Emits SensorUpdate in the thread of the object not more often than interface updates
+
+  // Pipeline statistics. Histograms are in microseconds and are kept for the whole run
+  LatencyHistogram report_interval_; //!< Between arrivals of consecutive reports
+  LatencyHistogram publish_latency_; //!< From arrival of a report to publishing of the pose
+  LatencyHistogram pose_age_; //!< From publishing of the pose to its reading by the renderer
+  std::chrono::steady_clock::time_point last_report_; //!< Arrival of the previous report. Used by the reader thread only
+  std::atomic<uint64_t> short_reads_; //!< Reports of wrong size
+  std::atomic<uint64_t> dropouts_; //!< Readings stopped by device error
 
   std::string GetSensorDevice();
 
+  /*! Opens or closes the device. Should be called under device_lock_ */
+  bool Open(const std::string& hid_path, const std::string& serial);
+  void Close();
+
+  /*! Executes requests of RequestOpen and RequestClose */
+  void WorkOpen();
+
+  /*! Integrates rotation by reports received at one wakeup */
+  void ProcessReports(const std::vector<SensorReport>& reports);
+
+  /*! Publishes current orientation for rendering. Should be called under angle_lock_
+  \return time of publishing */
+  std::chrono::steady_clock::time_point PublishPose(std::chrono::steady_clock::time_point time);
+
 };
 
 #endif //PSVR_PSVR_H
@@ -20,23 +20,58 @@
 #define PSVR_CONTROL_16092022_H
 
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include "session_record.h"
 
 
 /*! Class for control PSVR mode and settings
- *  Class isn't thread-safe.
+ *  Commands are queued and executed by the worker thread in order of calls,
+ *  so a slow or hung control interface doesn't block the caller. Methods are
+ *  thread-safe. Completion callbacks are called from the worker thread.
 */
 class PsvrControl {
  public:
+  /*! Completion of the command. The parameter is success of the command */
+  typedef std::function<void(bool)> Callback;
+
   PsvrControl();
   virtual ~PsvrControl();
 
-  bool OpenDevice();
-  void CloseDevice();
+  /*! Opens the control interface found by enumeration */
+  void OpenDevice(Callback callback = Callback());
+
+  /*! Opens the control interface
+  \param hid_path hidapi path of the interface */
+  void OpenDevice(const std::string& hid_path, Callback callback = Callback());
+  void CloseDevice(Callback callback = Callback());
 
+  /*! The device is opened by the last executed command */
   bool IsOpened();
 
-  bool SetVRMode(bool vrmode);
+  void SetVRMode(bool vrmode, Callback callback = Callback());
+
+  /*! Switches the headset on or off */
+  void SetPower(bool on, Callback callback = Callback());
+
+  /*! Drops callbacks of queued commands and waits for the running callback.
+  Called by owners of callbacks before destruction. Shouldn't be called from
+  callbacks */
+  void ClearCallbacks();
+
+  /*! Sets session mode. Commands are written into the recorder. On replay
+  there is no hardware: the device is always opened, commands are logged and
+  acknowledged */
+  void SetSession(std::shared_ptr<SessionRecorder> recorder, bool replay);
 
 
  private:
@@ -49,17 +84,70 @@ class PsvrControl {
   const unsigned short kPsvrProductID = 0x09af;
   const char kPsvrControlInterface[4] = ":05";
   static const size_t kMaxBufferSize = 128;
-
+  const std::chrono::milliseconds kCommandTimeout{2000}; //!< Command waiting in the queue longer is failed without execution
+  const std::chrono::milliseconds kWriteTimeout{1000}; //!< Device not completing writing longer is abandoned, so the worker isn't blocked
+  const int kWriteAttempts = 3;
+  const std::chrono::milliseconds kRetryDelay{50};
+
+  enum CommandType {
+    kOpenCommand,
+    kCloseCommand,
+    kVRModeCommand,
+    kPowerCommand
+  };
+
+  struct Command {
+    CommandType type;
+    bool value;
+    std::string path; //!< Path of the interface for opening. Empty for enumeration
+    std::chrono::steady_clock::time_point deadline;
+    std::vector<Callback> callbacks;
+    uint64_t generation; //!< Callbacks are called if ClearCallbacks wasn't called after queueing
+  };
+
+  // State of the device. Used by the worker only
   unsigned char buffer_[kMaxBufferSize];
   void* device_; //!< Opened control device with hid_device* type. Or nullptr
+  bool replay_opened_;
+  bool vr_mode_known_; //!< The mode was set by the player, so it's known
+  bool vr_mode_;
+  bool power_known_;
+  bool power_;
+  std::shared_ptr<SessionRecorder> recorder_;
+  bool replay_;
+
+  std::atomic_bool opened_;
+
+  std::mutex lock_; //!< Lock for the queue and session settings
+  std::condition_variable queue_cv_;
+  std::deque<Command> queue_;
+  std::shared_ptr<SessionRecorder> session_recorder_; //!< Session settings, applied by the worker on command start
+  bool session_replay_;
+  uint64_t callback_generation_;
+  bool stop_;
+  std::mutex callback_lock_; //!< Lock held while callbacks are called
+  std::thread worker_;
+
+  /*! Queues the command. Command of the same type at the end of the queue is
+  replaced, because only the last one makes sense */
+  void Enqueue(CommandType type, bool value, const std::string& path, Callback callback);
+  void Work();
+  bool Execute(const Command& cmd);
+
+  bool Open(const std::string& hid_path);
+  void Close();
+
+  /*! Writes the setting command unless the setting is already applied */
+  bool WriteSetting(unsigned char id, bool value, bool& known, bool& current);
 
   std::string GetControlDevice();
   void ReadCurrentSettings();
   void RestoreCurrentSettings();
 
-
-
-
+  /*! Writes command from buffer_ to the device. Failed writing is retried.
+  If writing isn't completed in kWriteTimeout, the device is abandoned without
+  closing and the control becomes closed */
+  bool WriteCommand(size_t size);
 };
 
 #endif // PSVR_CONTROL_H
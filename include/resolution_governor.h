@@ -0,0 +1,83 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef RESOLUTION_GOVERNOR_PSVR_PLAYER_13072024
+#define RESOLUTION_GOVERNOR_PSVR_PLAYER_13072024
+
+#include <cstddef>
+#include <cstdint>
+
+/*! Выбирает масштаб буфера глаз по измеренному времени кадра на GPU, чтобы
+кадр укладывался в период обновления экрана. Учитывается только время
+этапов, которые зависят от масштаба (рисование глаз), и сравнивается с той
+частью периода, что остаётся после остальных этапов (загрузка кадра видео,
+наложение). Масштаб задаётся по каждой оси в пределах [min, max] и меняется
+шагами kScaleStep. Гистерезис: масштаб уменьшается, если несколько кадров
+подряд глаза заняли больше kHighLoad оставшегося времени, и увеличивается на
+шаг, только если долго занимали меньше kLowLoad. Если остальные этапы сами
+не укладываются в период, масштаб не меняется: уменьшение не поможет. После
+изменения кадры, нарисованные ещё со старым масштабом, не учитываются.
+Каждое изменение выводится в лог с причиной */
+class ResolutionGovernor {
+ public:
+  ResolutionGovernor();
+
+  /*! Задаёт пределы масштаба. Текущий масштаб ограничивается ими. Равные
+  пределы задают постоянный масштаб */
+  void SetBounds(float min_scale, float max_scale);
+
+  /*! Задаёт период кадра (период обновления экрана), мкс */
+  void SetFrameBudget(uint64_t budget_us);
+
+  float GetScale() const { return scale_; }
+
+  /*! Учитывает время GPU очередного кадра
+  \param scaled_us время этапов, пропорциональное квадрату масштаба, мкс
+  \param fixed_us время остальных этапов кадра, мкс
+  \return масштаб изменился, новый выдаёт GetScale() */
+  bool AddFrame(uint64_t scaled_us, uint64_t fixed_us);
+
+ private:
+  const float kScaleStep = 0.05f;
+  const double kHighLoad = 0.9; //!< Доля оставшегося времени, выше которой масштаб уменьшается
+  const double kTargetLoad = 0.75; //!< Доля оставшегося времени, на которую рассчитывается уменьшенный масштаб
+  const double kLowLoad = 0.6; //!< Доля оставшегося времени, ниже которой масштаб увеличивается
+  static const size_t kOverloadFrames = 3; //!< Столько кадров подряд выше kHighLoad уменьшают масштаб
+  static const size_t kUnderloadFrames = 120; //!< Столько кадров подряд ниже kLowLoad увеличивают масштаб
+  static const size_t kSettleFrames = 8; //!< Кадры после изменения, которые не учитываются (время GPU приходит с задержкой)
+
+  float min_scale_;
+  float max_scale_;
+  float scale_;
+  uint64_t budget_us_;
+  size_t overload_count_;
+  uint64_t overload_sum_; //!< Сумма времени глаз в кадрах подряд выше kHighLoad
+  uint64_t overload_left_sum_; //!< Сумма оставшегося для глаз времени в тех же кадрах
+  size_t underload_count_;
+  size_t settle_count_;
+
+  /*! Меняет масштаб и выводит изменение в лог
+  \param reason, load причина: время глаз больше ("over") или меньше ("under") доли load
+  оставшегося времени
+  \param scaled_us, left_us время глаз, по которому меняется масштаб, и оставшееся для них время, мкс */
+  void ChangeScale(float scale, const char* reason, double load, double scaled_us, double left_us);
+
+  void ResetCounters();
+};
+
+#endif
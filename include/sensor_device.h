@@ -0,0 +1,68 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SENSOR_DEVICE_PSVR_PLAYER_26062024
+#define SENSOR_DEVICE_PSVR_PLAYER_26062024
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+const size_t kSensorReportSize = 64;
+
+/*! Sensor report of the helmet with the moment of its arrival */
+struct SensorReport {
+  unsigned char data[kSensorReportSize];
+  size_t size;
+  std::chrono::steady_clock::time_point time; //!< Time of arrival (wakeup of the reader)
+};
+
+/*! Source of sensor reports. Reports are read by one thread, Interrupt can be
+called from any thread */
+class SensorDevice {
+ public:
+  virtual ~SensorDevice() {}
+
+  /*! Waits for sensor reports and appends all queued ones to reports.
+  \param reports received reports
+  \param timeout_ms maximum waiting time
+  \return false if the device fails (e.g. it's switched off) */
+  virtual bool WaitReports(std::vector<SensorReport>& reports, int timeout_ms) = 0;
+
+  /*! Wakes up WaitReports before timeout */
+  virtual void Interrupt() = 0;
+
+  /*! Backend name for diagnostics */
+  virtual const char* GetName() const = 0;
+};
+
+/*! Opens the sensor interface of the helmet. On Linux hidraw node of the
+interface is used directly (epoll based waiting), hidapi is the fallback.
+\param hid_path hidapi path of the sensor interface. The hidraw node is taken
+from the same USB device. Empty path opens the first helmet found by hidraw
+\return opened device or empty pointer */
+std::unique_ptr<SensorDevice> OpenSensorDevice(const std::string& hid_path);
+
+/*! Sets SCHED_FIFO scheduling for the calling thread.
+\param priority realtime priority (1-99). 0 keeps default scheduling
+\return true if the priority is applied */
+bool SetRealtimePriority(int priority);
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SEQ_LOCK_PSVR_PLAYER_03072024
+#define SEQ_LOCK_PSVR_PLAYER_03072024
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/*! Sequence lock for publishing a value from one writer thread to any number
+of readers. The writer never waits, readers never block: they retry copying
+if the value was changed during the copy. The value is stored in atomic words,
+so a torn copy is detected without data races */
+template<typename T>
+class SeqLock {
+  static_assert(std::is_trivially_copyable<T>::value, "SeqLock value must be trivially copyable");
+
+ public:
+  SeqLock(): sequence_(0), loads_(0), retries_(0) {
+    Store(T());
+  }
+
+  /*! Publishes the value. Should be called by one thread at a time */
+  void Store(const T& value) {
+    uint64_t words[kWordCount] = {};
+    memcpy(words, &value, sizeof(T));
+
+    uint32_t seq = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kWordCount; ++i) {
+      words_[i].store(words[i], std::memory_order_relaxed);
+    }
+    sequence_.store(seq + 2, std::memory_order_release);
+  }
+
+  /*! Copies the last published value
+  \return number of retries caused by concurrent Store */
+  uint32_t Load(T& value) const {
+    uint64_t words[kWordCount];
+    uint32_t retries = 0;
+    while (true) {
+      uint32_t seq = sequence_.load(std::memory_order_acquire);
+      if ((seq & 1) == 0) {
+        for (size_t i = 0; i < kWordCount; ++i) {
+          words[i] = words_[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence_.load(std::memory_order_relaxed) == seq) {
+          break;
+        }
+      }
+      ++retries;
+    }
+    memcpy(&value, words, sizeof(T));
+
+    loads_.fetch_add(1, std::memory_order_relaxed);
+    if (retries) {
+      retries_.fetch_add(retries, std::memory_order_relaxed);
+    }
+    return retries;
+  }
+
+  /*! Returns total number of loads and retries in them. Contention of readers
+  and the writer is retries / loads */
+  void GetStatistics(uint64_t& loads, uint64_t& retries) const {
+    loads = loads_.load(std::memory_order_relaxed);
+    retries = retries_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  static const size_t kWordCount = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  std::atomic<uint32_t> sequence_; //!< Odd value means the writer is changing the value
+  std::atomic<uint64_t> words_[kWordCount];
+  mutable std::atomic<uint64_t> loads_;
+  mutable std::atomic<uint64_t> retries_;
+};
+
+#endif
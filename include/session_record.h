@@ -0,0 +1,98 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SESSION_RECORD_PSVR_PLAYER_04072024
+#define SESSION_RECORD_PSVR_PLAYER_04072024
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "sensor_device.h"
+
+/*! Session file: "PSVRSES1" signature and records. Every record is type (1 byte),
+data size (1 byte), time from the previous record in microseconds (4 bytes,
+little endian) and data */
+enum SessionRecordType: uint8_t {
+  kSessionSensorReport = 1, //!< Report of the sensor interface
+  kSessionControlCommand = 2 //!< Command written to the control interface
+};
+
+const size_t kMaxSessionRecordSize = 255;
+
+struct SessionRecord {
+  SessionRecordType type;
+  uint64_t time_us; //!< Time from the session start
+  size_t size;
+  unsigned char data[kMaxSessionRecordSize];
+};
+
+/*! Writes sensor reports and control commands of the helmet into session file.
+Methods are thread-safe */
+class SessionRecorder {
+ public:
+  SessionRecorder();
+
+  bool Open(const std::string& fname);
+
+  void WriteReport(const SensorReport& report);
+
+  void WriteCommand(const unsigned char* data, size_t size);
+
+ private:
+  std::mutex lock_;
+  std::ofstream file_;
+  std::chrono::steady_clock::time_point start_;
+  uint64_t last_time_us_;
+
+  void WriteRecord(SessionRecordType type, std::chrono::steady_clock::time_point time,
+      const unsigned char* data, size_t size);
+};
+
+/*! Reads records of session file one by one */
+class SessionReader {
+ public:
+  SessionReader();
+
+  bool Open(const std::string& fname);
+
+  /*! Reads the next record.
+  \return false at the end of the file or on broken record */
+  bool Next(SessionRecord& record);
+
+ private:
+  std::ifstream file_;
+  uint64_t time_us_;
+};
+
+/*! Opens session file as the sensor device. Reports are returned in time of
+their recording or as fast as possible. The end of the session is reported
+as device failure.
+\param fname session file
+\param fast don't wait for time of reports
+\return opened device or empty pointer */
+std::unique_ptr<SensorDevice> OpenReplaySensorDevice(const std::string& fname, bool fast);
+
+/*! Wraps the device: all its reports are written into the session */
+std::unique_ptr<SensorDevice> MakeRecordingSensorDevice(std::unique_ptr<SensorDevice> device,
+    std::shared_ptr<SessionRecorder> recorder);
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SHADER_PERMUTATIONS_PSVR_PLAYER_08072024
+#define SHADER_PERMUTATIONS_PSVR_PLAYER_08072024
+
+#include <map>
+#include <vector>
+
+#include <QByteArray>
+#include <QOpenGLShaderProgram>
+#include <QString>
+
+#include "program_cache.h"
+
+/*! Варианты программы шейдеров для наборов возможностей. Каждому биту набора
+соответствует #define, который вставляется в исходный текст шейдеров после
+строки #version. Так в каждом кадре работает шейдер без ветвлений по
+настройкам. Вариант компилируется при первом запросе и хранится до удаления
+родителя. Используется в потоке OpenGL */
+class ShaderPermutations {
+ public:
+  /*! \param vertex_file, fragment_file файлы шейдеров (ресурсы)
+  \param defines имена макросов для битов набора, начиная с младшего
+  \param attributes имена атрибутов вершин. Номер атрибута равен индексу, так
+  что массивы вершин подходят для всех вариантов
+  \param cache дисковый кэш собранных программ или nullptr
+  \param parent родитель программ */
+  ShaderPermutations(const QString& vertex_file, const QString& fragment_file,
+      const std::vector<const char*>& defines, const std::vector<const char*>& attributes,
+      ProgramBinaryCache* cache, QObject* parent);
+
+  /*! Выдаёт программу для набора возможностей. При первом запросе загружает
+  её из кэша или собирает, время выводится в лог. Если программа не собралась,
+  то ошибка выводится в лог, а программа остаётся несобранной */
+  QOpenGLShaderProgram* Get(unsigned features);
+
+ private:
+  QString vertex_file_;
+  QString fragment_file_;
+  std::vector<const char*> defines_;
+  std::vector<const char*> attributes_;
+  ProgramBinaryCache* cache_;
+  QObject* parent_;
+  QByteArray vertex_source_;
+  QByteArray fragment_source_;
+  std::map<unsigned, QOpenGLShaderProgram*> programs_;
+
+  /*! Вставляет макросы набора после строки #version */
+  QByteArray MakeSource(const QByteArray& source, unsigned features) const;
+};
+
+#endif
@@ -1,23 +1,67 @@
 #ifndef TILE_PSVR_PLAYER_04052024
 #define TILE_PSVR_PLAYER_04052024
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
+/*! Прямоугольная область полотна в пикселях */
+struct TileRect {
+  size_t x;
+  size_t y;
+  size_t width;
+  size_t height;
+};
+
+/*! Тип строки tile-а. Используется для быстрого наложения: прозрачные строки
+пропускаются, непрозрачные копируются, смешиваются только остальные */
+enum TileRowKind: uint8_t {
+  kTransparentRow,
+  kOpaqueRow,
+  kMixedRow
+};
+
+/*! Картинка, подготовленная для наложения на полотно.
+Каждый пиксель представляется 4-х байтным числом с последовательностью rgba,
+цвет предумножен на прозрачность (premultiplied alpha) */
+struct TileImage {
+  size_t width;
+  size_t height;
+  std::vector<uint32_t> pixels;
+  std::vector<uint8_t> row_kinds; //!< Тип каждой строки (TileRowKind)
+};
+
+/*! Подготавливает tile из обычной картинки rgba: предумножает цвет на
+прозрачность и определяет типы строк.
+\param image подготовленная картинка
+\param rgba пиксели исходной картинки
+\param width ширина исходной картинки в пикселях. Размер rgba должен делиться
+на ширину без остатка */
+void MakeTileImage(TileImage& image, const std::vector<uint32_t>& rgba, size_t width);
+
+/*! Предумножает цвет пикселей на их прозрачность */
+void PremultiplyPixels(uint32_t* pixels, size_t count);
+
 /*! Добавляет tile (прямоугольную картинку) на исходное полотно canvas.
-Tile и Canvas должны быть строго прямоугольными.
-каждый пиксель представляется 4-х байтным числом с последовательностью rgba
-Для обработки прозрачности используется последний байт. Tile отрисовывается
-только в границах Canvas.
+Tile и Canvas должны быть строго прямоугольными. Пиксели полотна и tile-а
+хранятся с предумноженной прозрачностью. Tile отрисовывается только в границах
+Canvas и области clip (координаты полотна).
 \param canvas полотно, на которое добавляется tile
 \param canvas_width ширина полотна в пикселях
 \param tile рисуемый фрагмент
-\param tile_width ширина tile-а в пикселях
 \param xpos, ypos позиция размещения tile на canvas
+\param clip область полотна, в которой можно изменять пиксели
 */
 void AddTile(std::vector<uint32_t>& canvas, size_t canvas_width,
-    const std::vector<uint32_t>& tile, size_t tile_width,
-    size_t xpos, size_t ypos);
+    const TileImage& tile, size_t xpos, size_t ypos, const TileRect& clip);
+
+/*! Смешивает строку пикселей src поверх строки dst (предумноженная
+прозрачность): dst = src + dst * (255 - src.alpha) / 255 */
+void BlendRow(uint32_t* dst, const uint32_t* src, size_t count);
+
+/*! Возвращает пересечение областей. Если области не пересекаются, то
+возвращается область нулевого размера */
+TileRect IntersectRects(const TileRect& r1, const TileRect& r2);
 
 
 #endif
@@ -0,0 +1,51 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef VIDEO_DATA_PSVR_PLAYER_12072024
+#define VIDEO_DATA_PSVR_PLAYER_12072024
+
+#include <memory>
+#include <vector>
+
+/*! Information about pixel data */
+class VideoDataInfo {
+ public:
+  VideoDataInfo(unsigned int width, unsigned int height) {
+    width_ = width;
+    height_ = height;
+    data_.resize(width_ * height_ * 3);
+  }
+
+  unsigned char* GetData() { return data_.data(); }
+  unsigned int GetWidth() { return width_; }
+  unsigned int GetHeight() { return height_; }
+  size_t GetDataRawSize() { return data_.size(); }
+
+ private:
+  VideoDataInfo() = delete;
+  VideoDataInfo(const VideoDataInfo&) = delete;
+  VideoDataInfo& operator=(const VideoDataInfo&) = delete;
+
+  unsigned int width_;
+  unsigned int height_;
+  std::vector<unsigned char> data_;
+};
+
+using VideoDataInfoPtr = std::shared_ptr<VideoDataInfo>;
+
+#endif
@@ -19,6 +19,7 @@
 #ifndef PSVR_VIDEOPLAYER_H
 #define PSVR_VIDEOPLAYER_H
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 
@@ -27,31 +28,8 @@
 
 #include <vlc/vlc.h>
 
-/*! Information about pixel data */
-class VideoDataInfo {
- public:
-  VideoDataInfo(unsigned int width, unsigned int height) {
-    width_ = width;
-    height_ = height;
-    data_.resize(width_ * height_ * 3);
-  }
-
-  unsigned char* GetData() { return data_.data(); }
-  unsigned int GetWidth() { return width_; }
-  unsigned int GetHeight() { return height_; }
-  size_t GetDataRawSize() { return data_.size(); }
-
- private:
-  VideoDataInfo() = delete;
-  VideoDataInfo(const VideoDataInfo&) = delete;
-  VideoDataInfo& operator=(const VideoDataInfo&) = delete;
-
-  unsigned int width_;
-  unsigned int height_;
-  std::vector<unsigned char> data_;
-};
-
-using VideoDataInfoPtr = std::shared_ptr<VideoDataInfo>;
+#include "coalescing_notifier.h"
+#include "video_data.h"
 
 /*! Кэш для блоков видеоданных */
 class VideoDataCache {
@@ -109,6 +87,9 @@ class VideoPlayer : public QObject
 
 		bool IsPlaying();
 
+    /*! Выдаёт текущее время проигрывания в мс или -1, если видео не загружено */
+    int64_t GetTime();
+
 
 		void *VLC_Lock(void **p_pixels);
 		void VLC_Unlock(void *id, void *const *p_pixels);
@@ -124,14 +105,27 @@ class VideoPlayer : public QObject
   /*! Выдаёт последнюю текстуру/экран для вывода */
   VideoDataInfoPtr GetLastScreen();
 
+  /*! Выдаёт количество декодированных кадров, заменённых следующим кадром до
+  вывода на экран */
+  uint64_t GetDroppedFrames() const { return dropped_frames_; }
+
  private:
   VideoDataCache video_cache_; //!< Кэш с блоками видеоданных (чтобы не перевыделять постоянно память)
   VideoDataInfoPtr last_vlc_frame_; // Current data for playing
   VideoDataInfoPtr vlc_locked_data_; //!< Видеоданные, которые сейчас заполянются vlc библиотекой (декодированный кадр)
   VideoDataInfoPtr last_screen_; //!< Последнее изображение для вывода на экран
   bool need_update_screen_; //!< Признак, что необходимо пересчитать последний экран
+  std::atomic<uint64_t> dropped_frames_; //!< Кадры, не попавшие на экран
   std::mutex video_data_lock_; // Lock for current_data_ only
 
+  // События vlc приходят из его потоков с частотой кадров. В очередь
+  // интерфейса попадает не больше одного события за период обновления
+  CoalescingNotifier frame_notifier_;
+  CoalescingValue<float> position_notifier_;
+
+ private slots:
+  void DeliverPosition();
+
 	signals:
 		void DisplayVideoFrame();
 
@@ -0,0 +1,80 @@
+#version 330
+
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+// Вариант шейдера PREMULTIPLY задаётся программой (см. ShaderPermutations)
+// для текстур, хранящих цвет без предумножения на прозрачность
+
+uniform sampler2D tex_overlay;
+
+in vec2 info_pos_var;
+in vec2 uv_var;
+flat in vec4 uv_rect_var;
+flat in vec2 uv_scale_var;
+
+// Цвет (предумноженный) и прозрачность смешиваются отдельно для каждого канала
+// (dual source blending): glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC1_COLOR)
+layout(location = 0, index = 0) out vec4 color_out;
+layout(location = 0, index = 1) out vec4 factor_out;
+
+
+// Смещение зелёного и синего цвета для компенсации хроматической аберрации.
+// Координаты поля информации
+vec2 GetGreenPosition(vec2 pos) {
+  pos.y += 0.0015;
+  pos.x /= 0.995;
+  pos.y /= 0.994;
+  return pos;
+}
+
+vec2 GetBluePosition(vec2 pos) {
+  pos.x -= 0.0015;
+  pos.y += 0.002;
+  pos.x /= 0.990;
+  pos.y /= 0.990;
+  return pos;
+}
+
+vec4 GetOverlayColor(vec2 pos) {
+  vec2 uv = uv_var + (pos - info_pos_var) * uv_scale_var;
+  if (uv.x < uv_rect_var.x || uv.x > uv_rect_var.z ||
+      uv.y < uv_rect_var.y || uv.y > uv_rect_var.w) {
+    return vec4(0.0);
+  }
+
+  // Не выходим за картинку, чтобы не подмешивать соседние картинки атласа
+  vec2 half_texel = 0.5 / vec2(textureSize(tex_overlay, 0));
+  uv = clamp(uv, uv_rect_var.xy + half_texel, uv_rect_var.zw - half_texel);
+  vec4 color = texture(tex_overlay, uv);
+#ifdef PREMULTIPLY
+  color.rgb *= color.a;
+#endif
+  return color;
+}
+
+void main(void)
+{
+  vec4 red = GetOverlayColor(info_pos_var);
+  vec4 green = GetOverlayColor(GetGreenPosition(info_pos_var));
+  vec4 blue = GetOverlayColor(GetBluePosition(info_pos_var));
+
+  color_out = vec4(red.r, green.g, blue.b, red.a);
+  factor_out = vec4(red.a, green.a, blue.a, red.a);
+}
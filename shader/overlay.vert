@@ -0,0 +1,67 @@
+#version 330
+
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+
+/*! Проход наложения (информации). Вершины прямоугольников наложения заданы в
+координатах поля информации: x = -1 - +1 слева направо, y = -1 - +1 сверху
+вниз. Наложение не зависит от положения головы и одинаково для обоих глаз */
+
+in vec2 info_pos_attr; //!< Координаты вершины на поле информации
+in vec2 uv_attr; //!< Текстурные координаты вершины
+in vec4 uv_rect_attr; //!< Область картинки в текстуре: min u, min v, max u, max v
+in vec2 uv_scale_attr; //!< Изменение текстурных координат на единицу координат поля
+
+out vec2 info_pos_var;
+out vec2 uv_var;
+flat out vec4 uv_rect_var;
+flat out vec2 uv_scale_var;
+
+
+// Коррекция дисторсии, такая же как в sphere.vert
+vec4 FixDistorsion(vec4 pos) {
+  vec2 cpos;
+  cpos.x = pos.x / pos.z / pos.w;
+  cpos.y = pos.y / pos.z / pos.w;
+  float len = length(cpos);
+
+  if (len > 1.5) { return pos; }
+  float km1 = -0.02328336 * len * len * len + 0.33334678 * len * len -
+      0.10098184 * len + 1.00274654;
+  float k = 1.0 / km1;
+
+  pos.x *= k;
+  pos.y *= k;
+  return pos;
+}
+
+void main(void)
+{
+  vec4 screen_scale = vec4(1.15, 1.0, 1.0, 1.0);
+
+  vec4 scr_pos = vec4(info_pos_attr.x, -info_pos_attr.y, -1.0, 1.0);
+  gl_Position = FixDistorsion(scr_pos);
+  gl_Position *= screen_scale;
+  gl_Position.z = 0.0;
+
+  info_pos_var = info_pos_attr;
+  uv_var = uv_attr;
+  uv_rect_var = uv_rect_attr;
+  uv_scale_var = uv_scale_attr;
+}
@@ -18,13 +18,15 @@
  *
  */
 
+// Варианты шейдера задаются программой (см. ShaderPermutations):
+// CYLINDER_SCREEN - видео на плоском экране (цилиндре) перед зрителем, иначе на сфере;
+// FULL_SPHERE - сферическое видео на все 360 градусов, обрезка по углу не нужна
+
 #define M_PI 3.1415926535897932384626433832795
 
 uniform sampler2D tex_uni;
-uniform sampler2D tex_info;
 uniform vec4 min_max_uv_uni;
 uniform float projection_angle_factor_uni;
-uniform bool cylinder_type;
 uniform mat4 modelview_projection_uni;
 
 in vec4 position_var;
@@ -33,10 +35,6 @@ in float blue_y_disp;
 in float green_x_disp;
 in float green_y_disp;
 
-in vec4 info_red_position;
-in vec4 info_green_position;
-in vec4 info_blue_position;
-
 
 out vec4 color_out;
 
@@ -79,33 +77,19 @@ vec4 GetSphereColor(vec3 position) {
     sphere_coord.x = 1.0 - sphere_coord.x;
   }
 
+#ifndef FULL_SPHERE
   sphere_coord.x -= 0.5;
   sphere_coord.x *= projection_angle_factor_uni;
   sphere_coord.x += 0.5;
 
-  vec3 color;
-
   if(sphere_coord.x < 0.0 || sphere_coord.x > 1.0)
   {
-    color = vec3(0.0);
+    return vec4(0.0, 0.0, 0.0, 1.0);
   }
-  else
-  {
-    vec2 uv = min_max_uv_uni.xy + (min_max_uv_uni.zw - min_max_uv_uni.xy) * sphere_coord;
-    color = texture(tex_uni, uv).rgb;
-  }
-
-  return vec4(color, 1.0);
-}
+#endif
 
-
-vec4 GetInfoColor(vec3 pos) {
-  vec4 info_color = vec4(0, 0, 0, 0);
-  vec2 pos2 = (pos.xy + vec2(1.0, 1.0)) * vec2(0.5, 0.5);
-  if (pos2.x > 0 && pos2.x < 1 && pos2.y > 0 && pos2.y < 1) {
-    info_color = texture(tex_info, pos2);
-  }
-  return info_color;
+  vec2 uv = min_max_uv_uni.xy + (min_max_uv_uni.zw - min_max_uv_uni.xy) * sphere_coord;
+  return vec4(texture(tex_uni, uv).rgb, 1.0);
 }
 
 
@@ -175,34 +159,13 @@ void main(void)
   pos_green.x += pos_green.z * green_x_disp;
   pos_green.y += pos_green.z * green_y_disp;
 
-  if (cylinder_type) {
-    color_out = GetCylinderColor(pos_red);
-    color_out.b = GetCylinderColor(pos_blue).b;
-    color_out.g = GetCylinderColor(pos_green).g;
-  }
-  else {
-    color_out = GetSphereColor(pos_red);
-    color_out.b = GetSphereColor(pos_blue).b;
-    color_out.g = GetSphereColor(pos_green).g;
-  }
-
-  // Координаты отображения для красного (info_red_position),
-  // зелёного (info_green_position) и синего (info info_blue_position) цвета
-  // Координаты поля: x = -1 - +1; y = -1 - +1; z = -1
-  // Координата x возрастает слева (-1) - направо (+1);
-  // у возрастает снизу (-1) вверх (+1)
-  // Координаты могут выходить за границы поля или быть меньше, т.к. есть
-  // коррекция глазного расстояния
-
-//  return;
-//  color_out = GetBarsColor(info_red_position);
-//  return;
-  // Наложим маску информации
-  vec4 infor = GetInfoColor(info_red_position.xyz);
-  vec4 infog = GetInfoColor(info_green_position.xyz);
-  vec4 infob = GetInfoColor(info_blue_position.xyz);
-
-  color_out.r = color_out.r * (1.0 - infor.a) + infor.r * infor.a;
-  color_out.g = color_out.g * (1.0 - infog.a) + infog.g * infog.a;
-  color_out.b = color_out.b * (1.0 - infob.a) + infob.b * infob.a;
+#ifdef CYLINDER_SCREEN
+  color_out = GetCylinderColor(pos_red);
+  color_out.b = GetCylinderColor(pos_blue).b;
+  color_out.g = GetCylinderColor(pos_green).g;
+#else
+  color_out = GetSphereColor(pos_red);
+  color_out.b = GetSphereColor(pos_blue).b;
+  color_out.g = GetSphereColor(pos_green).g;
+#endif
 }
@@ -19,7 +19,8 @@
  */
 
 
-// #define DEBUG_DISTORSION
+// Отладочная коррекция дисторсии по точкам включается макросом
+// DEBUG_DISTORSION, его задаёт программа (см. ShaderPermutations)
 
 
 /*! Смещение изображения к центру в размерности изображения для компенсации
@@ -35,27 +36,6 @@ out float blue_y_disp;
 out float green_x_disp;
 out float green_y_disp;
 
-out vec4 info_red_position;
-out vec4 info_green_position;
-out vec4 info_blue_position;
-
-
-vec4 GetGreenPosition(vec4 pos) {
-  pos.y += 0.0015 * pos.w;
-  pos.x /= 0.995;
-  pos.y /= 0.994;
-  return pos;
-}
-
-
-vec4 GetBluePosition(vec4 pos) {
-  pos.x -= 0.0015 * pos.w;
-  pos.y += 0.002 * pos.w;
-  pos.x /= 0.990;
-  pos.y /= 0.990;
-  return pos;
-}
-
 #ifdef DEBUG_DISTORSION
 
 float kDistorsion0 = 1.0; // Len = 0. It's center of screen. k = 1.0
@@ -140,18 +120,4 @@ void main(void)
   blue_y_disp = scr_pos.y / scr_pos.w * blue_y;
   green_x_disp = scr_pos.x / scr_pos.w * green_x;
   green_y_disp = scr_pos.y / scr_pos.w * green_y;
-
-
-  float info_scale = 1.0;
-  info_red_position = scr_pos;
-//  info_red_position.x /= info_red_position.z;
-  info_red_position.x /= info_scale;
-  info_red_position.y /= info_scale * -1.0;
-//  info_red_position.z = 1.0;
-  info_green_position = GetGreenPosition(info_red_position);
-  info_blue_position = GetBluePosition(info_red_position);
-
-//  info_red_position.x -= vertex_x_disp;
-//  info_green_position.x -= vertex_x_disp;
-//  info_blue_position.x -= vertex_x_disp;
 }
@@ -0,0 +1,53 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "coalescing_notifier.h"
+
+CoalescingNotifier::CoalescingNotifier(int period_ms, QObject* parent): QObject(parent),
+    pending_(false), notifies_(0), signals_(0), period_ms_(period_ms) {
+  delay_timer_.setSingleShot(true);
+  connect(&delay_timer_, SIGNAL(timeout()), this, SLOT(Deliver()));
+}
+
+void CoalescingNotifier::Notify() {
+  notifies_.fetch_add(1, std::memory_order_relaxed);
+  if (!pending_.exchange(true)) {
+    QMetaObject::invokeMethod(this, "Deliver", Qt::QueuedConnection);
+  }
+}
+
+void CoalescingNotifier::GetStatistics(uint64_t& notifies, uint64_t& signals_count) const {
+  notifies = notifies_.load(std::memory_order_relaxed);
+  signals_count = signals_;
+}
+
+void CoalescingNotifier::Deliver() {
+  if (last_signal_.isValid()) {
+    qint64 rest = period_ms_ - last_signal_.elapsed();
+    if (rest > 0) {
+      delay_timer_.start(static_cast<int>(rest));
+      return;
+    }
+  }
+
+  // Notifications during the signal processing request the next signal
+  pending_ = false;
+  last_signal_.start();
+  ++signals_;
+  emit Notified();
+}
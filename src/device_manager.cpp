@@ -0,0 +1,241 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "device_manager.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include <hidapi/hidapi.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const unsigned short kPsvrVendorID = 0x054c;
+const unsigned short kPsvrProductID = 0x09af;
+const char kPsvrSensorInterface[] = ":04";
+const char kPsvrControlInterface[] = ":05";
+
+bool HasSuffix(const std::string& s, const char* suffix) {
+  size_t len = strlen(suffix);
+  return s.length() >= len && s.compare(s.length() - len, len, suffix) == 0;
+}
+
+bool operator==(const HelmetInterfaces& a, const HelmetInterfaces& b) {
+  return a.present == b.present && a.sensor_path == b.sensor_path &&
+      a.control_path == b.control_path && a.serial == b.serial;
+}
+
+#ifdef __linux__
+const unsigned int kKernelEvents = 1; //!< Netlink group of kernel uevents
+const unsigned int kUdevEvents = 2; //!< Netlink group of events re-sent by udev
+const char kUdevPrefix[] = "libudev";
+const size_t kUdevPropertiesOffset = 16; //!< Offset of properties_off in the udev message header
+const char kUdevControl[] = "/run/udev/control"; //!< Exists while udev is running
+
+/*! Checks that uevent (kernel or udev one) is about hidraw device */
+bool IsHidrawEvent(const char* buffer, size_t size) {
+  // Kernel message is "action@devpath" and "KEY=value" strings separated by
+  // zeros. udev message has binary header with offset of the same strings
+  size_t pos = 0;
+  if (size >= kUdevPropertiesOffset + sizeof(uint32_t) &&
+      memcmp(buffer, kUdevPrefix, sizeof(kUdevPrefix)) == 0) {
+    uint32_t offset;
+    memcpy(&offset, buffer + kUdevPropertiesOffset, sizeof(offset));
+    pos = offset;
+  }
+  for (; pos < size; pos += strlen(buffer + pos) + 1) {
+    if (strcmp(buffer + pos, "SUBSYSTEM=hidraw") == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+#endif
+
+} // namespace
+
+
+HelmetInterfaces EnumerateHelmet() {
+  HelmetInterfaces res;
+  auto devs = hid_enumerate(kPsvrVendorID, kPsvrProductID);
+  for (auto dev = devs; dev; dev = dev->next) {
+    std::string p = dev->path ? dev->path : "";
+    if (HasSuffix(p, kPsvrSensorInterface)) {
+      res.sensor_path = p;
+      // Serial is used as settings key, so only letters and digits are taken
+      for (auto c = dev->serial_number; c && *c; ++c) {
+        if ((*c >= L'0' && *c <= L'9') || (*c >= L'A' && *c <= L'Z') || (*c >= L'a' && *c <= L'z')) {
+          res.serial.push_back(static_cast<char>(*c));
+        }
+      }
+    } else if (HasSuffix(p, kPsvrControlInterface)) {
+      res.control_path = p;
+    }
+  }
+  hid_free_enumeration(devs);
+  res.present = !res.sensor_path.empty() || !res.control_path.empty();
+  return res;
+}
+
+
+DeviceManager::DeviceManager(): stop_(false), stop_fd_(-1) {
+}
+
+DeviceManager::~DeviceManager() {
+  Stop();
+}
+
+void DeviceManager::Start(bool virtual_helmet) {
+  Stop();
+  stop_ = false;
+  if (virtual_helmet) {
+    {
+      std::lock_guard<std::mutex> lk(lock_);
+      interfaces_ = HelmetInterfaces();
+      interfaces_.present = true;
+    }
+    QMetaObject::invokeMethod(this, "HelmetChanged", Qt::QueuedConnection);
+    return;
+  }
+
+#ifdef __linux__
+  stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (stop_fd_ >= 0) {
+    std::thread thr(&DeviceManager::WatchHotplug, this);
+    std::swap(thread_, thr);
+    return;
+  }
+#endif
+  std::thread thr(&DeviceManager::WatchPolling, this);
+  std::swap(thread_, thr);
+}
+
+void DeviceManager::Stop() {
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lk(lock_);
+      stop_ = true;
+    }
+    stop_cv_.notify_all();
+#ifdef __linux__
+    if (stop_fd_ >= 0) {
+      uint64_t one = 1;
+      if (write(stop_fd_, &one, sizeof(one)) < 0) {
+        // Counter overflow only: the thread is woken up anyway
+      }
+    }
+#endif
+    thread_.join();
+  }
+
+#ifdef __linux__
+  if (stop_fd_ >= 0) {
+    close(stop_fd_);
+    stop_fd_ = -1;
+  }
+#endif
+}
+
+HelmetInterfaces DeviceManager::GetInterfaces() const {
+  std::lock_guard<std::mutex> lk(lock_);
+  return interfaces_;
+}
+
+void DeviceManager::Update() {
+  auto ifaces = EnumerateHelmet();
+  {
+    std::lock_guard<std::mutex> lk(lock_);
+    if (ifaces == interfaces_) {
+      return;
+    }
+    interfaces_ = ifaces;
+  }
+  QMetaObject::invokeMethod(this, "HelmetChanged", Qt::QueuedConnection);
+}
+
+void DeviceManager::WatchPolling() {
+  Update();
+  std::unique_lock<std::mutex> lk(lock_);
+  while (!stop_cv_.wait_for(lk, std::chrono::milliseconds(kPollIntervalMs), [this](){ return stop_.load(); })) {
+    lk.unlock();
+    Update();
+    lk.lock();
+  }
+}
+
+void DeviceManager::WatchHotplug() {
+#ifdef __linux__
+  int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+  sockaddr_nl addr = {};
+  addr.nl_family = AF_NETLINK;
+  // Kernel events come before udev has applied permissions of the new node,
+  // so the helmet would fail to open. udev re-sends them when the node is
+  // ready. Without udev (e.g. in a container) kernel events are taken
+  addr.nl_groups = access(kUdevControl, F_OK) == 0 ? kUdevEvents : kKernelEvents;
+  if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    WatchPolling();
+    return;
+  }
+
+  // Events before the first enumeration are covered by it
+  Update();
+
+  pollfd fds[2] = {{fd, POLLIN, 0}, {stop_fd_, POLLIN, 0}};
+  bool changed = false;
+  while (!stop_) {
+    // After an event waits for the rest of the helmet interfaces
+    int count = poll(fds, 2, changed ? kSettleMs : -1);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if (count == 0) {
+      changed = false;
+      Update();
+      continue;
+    }
+    if (fds[1].revents) {
+      break;
+    }
+
+    char buffer[4096];
+    ssize_t size;
+    while ((size = recv(fd, buffer, sizeof(buffer) - 1, 0)) > 0) {
+      buffer[size] = 0;
+      changed = changed || IsHidrawEvent(buffer, size);
+    }
+  }
+  close(fd);
+#else
+  WatchPolling();
+#endif
+}
@@ -0,0 +1,203 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "distortion_mesh.h"
+
+#include <cassert>
+#include <cmath>
+
+namespace {
+
+const double kMaxDistortionLen = 1.5; //!< Дальше коррекция в шейдере не применяется
+const double kBaseDensity = 0.2; //!< Плотность линий без кривизны. Не даёт ячейкам в центре стать слишком большими
+const size_t kDensitySteps = 4096; //!< Количество шагов численного интегрирования плотности
+const double kCurvatureStep = 0.001;
+const double kEdgeInset = 1e-4; //!< Вершины на краю коррекции ставятся чуть внутрь, чтобы шейдер их корректировал
+
+/*! Коэффициент коррекции без ограничения по расстоянию */
+double GetPolynomialFactor(double len) {
+  double km1 = -0.02328336 * len * len * len + 0.33334678 * len * len -
+      0.10098184 * len + 1.00274654;
+  return 1.0 / km1;
+}
+
+/*! Положение точки на экране после коррекции */
+double GetCorrected(double pos) {
+  return pos * GetPolynomialFactor(std::fabs(pos));
+}
+
+/*! Положение вершины сетки относительно края коррекции */
+enum VertexSide {
+  kInsideVertex,
+  kEdgeVertex, //!< На окружности края
+  kSnappedVertex, //!< Внутренняя, перенесена на окружность края
+  kOutsideVertex
+};
+
+/*! Ребро соединяет вершину внутри края (не на нём) с вершиной за краем */
+bool IsCrossingEdge(VertexSide side1, VertexSide side2) {
+  return (side1 == kInsideVertex && side2 == kOutsideVertex) ||
+      (side1 == kOutsideVertex && side2 == kInsideVertex);
+}
+
+/*! Удвоенная площадь треугольника с вершинами a, b, c. Положительна при обходе
+против часовой стрелки */
+double GetDoubleArea(const float* a, const float* b, const float* c) {
+  return (b[0] - a[0]) * (c[1] - a[1]) - (c[0] - a[0]) * (b[1] - a[1]);
+}
+
+/*! Плотность линий сетки: модуль второй производной положения после коррекции */
+double GetLineDensity(double pos) {
+  double curvature = (GetCorrected(pos + kCurvatureStep) - 2.0 * GetCorrected(pos) +
+      GetCorrected(pos - kCurvatureStep)) / (kCurvatureStep * kCurvatureStep);
+  return kBaseDensity + std::fabs(curvature);
+}
+
+} // namespace
+
+
+double GetDistortionFactor(double len) {
+  if (len > kMaxDistortionLen) {
+    return 1.0;
+  }
+  return GetPolynomialFactor(len);
+}
+
+void GenerateMeshLines(size_t count, double half_size, std::vector<double>& lines) {
+  assert(count >= 2);
+  // На краю коррекции коэффициент скачком становится 1. Линии ставятся на
+  // край по осям, остальные вершины края переносит GenerateDistortionMesh.
+  // Часть сетки за краем почти вся за экраном и рисуется одной ячейкой
+  lines.resize(count);
+  lines.front() = -half_size;
+  lines.back() = half_size;
+  double inner = half_size;
+  size_t first = 0;
+  if (half_size > kMaxDistortionLen && count >= 4) {
+    inner = kMaxDistortionLen;
+    first = 1;
+    lines[first] = -inner;
+    lines[count - 1 - first] = inner;
+  }
+
+  // Остальные линии делят интеграл плотности внутри края на равные части
+  std::vector<double> integral(kDensitySteps + 1);
+  double step = 2.0 * inner / kDensitySteps;
+  integral[0] = 0.0;
+  for (size_t i = 0; i < kDensitySteps; ++i) {
+    double pos = -inner + (i + 0.5) * step;
+    integral[i + 1] = integral[i] + GetLineDensity(pos) * step;
+  }
+
+  size_t cells = count - 1 - 2 * first;
+  size_t k = 0;
+  for (size_t i = 1; i < cells; ++i) {
+    double target = integral.back() * i / cells;
+    while (integral[k + 1] < target) {
+      ++k;
+    }
+    double part = (target - integral[k]) / (integral[k + 1] - integral[k]);
+    lines[first + i] = -inner + (k + part) * step;
+  }
+}
+
+void GenerateDistortionMesh(size_t count, double half_size, DistortionMesh& mesh) {
+  assert(count * count <= 65536);
+  std::vector<double> lines;
+  GenerateMeshLines(count, half_size, lines);
+
+  // Край коррекции - окружность, а линии прямые и совпадают с ней только на
+  // осях. Внутренние вершины, у которых соседняя по линии вершина за краем,
+  // переносятся по радиусу на окружность. Ячейка делится той диагональю,
+  // которая не соединяет внутреннюю вершину с внешней. Тогда ни один
+  // треугольник не смешивает скорректированную часть внутри края с частью
+  // за ним: скачок коэффициента остаётся только в треугольниках между
+  // окружностью и внешними вершинами
+  std::vector<VertexSide> sides(count * count);
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t j = 0; j < count; ++j) {
+      double len = std::hypot(lines[j], lines[i]);
+      sides[i * count + j] = len > kMaxDistortionLen ? kOutsideVertex :
+          (len == kMaxDistortionLen ? kEdgeVertex : kInsideVertex);
+    }
+  }
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t j = 0; j < count; ++j) {
+      // Центр редкой сетки некуда переносить
+      VertexSide& side = sides[i * count + j];
+      if (side == kInsideVertex && (lines[i] != 0.0 || lines[j] != 0.0) &&
+          ((i > 0 && sides[(i - 1) * count + j] == kOutsideVertex) ||
+          (i + 1 < count && sides[(i + 1) * count + j] == kOutsideVertex) ||
+          (j > 0 && sides[i * count + j - 1] == kOutsideVertex) ||
+          (j + 1 < count && sides[i * count + j + 1] == kOutsideVertex))) {
+        side = kSnappedVertex;
+      }
+    }
+  }
+
+  mesh.vertices.clear();
+  mesh.vertices.reserve(count * count * 3);
+  for (size_t i = 0; i < count; ++i) {
+    for (size_t j = 0; j < count; ++j) {
+      double x = lines[j];
+      double y = lines[i];
+      VertexSide side = sides[i * count + j];
+      if (side == kEdgeVertex || side == kSnappedVertex) {
+        double scale = kMaxDistortionLen * (1.0 - kEdgeInset) / std::hypot(x, y);
+        x *= scale;
+        y *= scale;
+      }
+      mesh.vertices.push_back(static_cast<float>(x));
+      mesh.vertices.push_back(static_cast<float>(y));
+      mesh.vertices.push_back(-1.0f);
+    }
+  }
+
+  // Обход треугольников против часовой стрелки, как у видимых граней.
+  // Диагональ lb-rt меняется на rb-lt, если она соединяет вершины по разные
+  // стороны края или если треугольник из вершин на окружности выворачивается
+  const float* v = mesh.vertices.data();
+  mesh.indices.clear();
+  mesh.indices.reserve((count - 1) * (count - 1) * 6);
+  for (size_t i = 0; i + 1 < count; ++i) {
+    for (size_t j = 0; j + 1 < count; ++j) {
+      uint16_t lb = static_cast<uint16_t>(i * count + j);
+      uint16_t rb = static_cast<uint16_t>(lb + 1);
+      uint16_t lt = static_cast<uint16_t>(lb + count);
+      uint16_t rt = static_cast<uint16_t>(lt + 1);
+      bool main_diagonal = !IsCrossingEdge(sides[lb], sides[rt]) &&
+          GetDoubleArea(v + lb * 3, v + rb * 3, v + rt * 3) > 0.0 &&
+          GetDoubleArea(v + rt * 3, v + lt * 3, v + lb * 3) > 0.0;
+      if (main_diagonal || IsCrossingEdge(sides[rb], sides[lt])) {
+        mesh.indices.push_back(lb);
+        mesh.indices.push_back(rb);
+        mesh.indices.push_back(rt);
+        mesh.indices.push_back(rt);
+        mesh.indices.push_back(lt);
+        mesh.indices.push_back(lb);
+      } else {
+        mesh.indices.push_back(lb);
+        mesh.indices.push_back(rb);
+        mesh.indices.push_back(lt);
+        mesh.indices.push_back(rb);
+        mesh.indices.push_back(rt);
+        mesh.indices.push_back(lt);
+      }
+    }
+  }
+}
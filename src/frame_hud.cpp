@@ -0,0 +1,127 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "frame_hud.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <initializer_list>
+
+namespace {
+
+/*! Форматирует время в мс или прочерк, если значений нет */
+std::string FormatMs(double value_ms, bool valid) {
+  char buffer[16];
+  if (!valid) {
+    return "   -";
+  }
+  snprintf(buffer, sizeof(buffer), "%4.1f", value_ms);
+  return buffer;
+}
+
+} // namespace
+
+
+void FrameHud::Accumulator::Add(uint64_t value) {
+  sum += value;
+  max = std::max(max, value);
+  ++count;
+}
+
+double FrameHud::Accumulator::GetAverageMs() const {
+  return count > 0 ? sum * 0.001 / count : 0.0;
+}
+
+double FrameHud::Accumulator::GetMaxMs() const {
+  return max * 0.001;
+}
+
+
+FrameHud::FrameHud(const GlyphAtlas& glyphs, size_t first_cell):
+    frame_graph_(glyphs, first_cell + kLines * kLineLength, kGraphColumns,
+        0, kLines * glyphs.GetCellHeight() + kGraphGap, kGraphWidth, kGraphHeight),
+    drops_graph_(glyphs, first_cell + kLines * kLineLength + kGraphColumns * 2, kGraphColumns,
+        kGraphWidth + kGraphGap, kLines * glyphs.GetCellHeight() + kGraphGap,
+        kGraphWidth, kGraphHeight),
+    visible_(false) {
+  lines_.reserve(kLines);
+  for (size_t i = 0; i < kLines; ++i) {
+    lines_.emplace_back(glyphs, first_cell + i * kLineLength, kLineLength, 0,
+        i * glyphs.GetCellHeight());
+  }
+  Clear();
+}
+
+void FrameHud::AddFrame(const FrameRecord& record) {
+  // Первый кадр не имеет интервала
+  if (record.interval_us > 0) {
+    interval_.Add(record.interval_us);
+  }
+  cpu_.Add(record.cpu_us);
+  upload_.Add(record.upload_us);
+  if (record.gpu_valid) {
+    gpu_.Add(GetGpuFrameTime(record));
+    gpu_upload_.Add(record.gpu_us[kGpuUpload]);
+  }
+  pose_age_.Add(record.pose_age_us);
+  dropped_video_ += record.dropped_video;
+}
+
+void FrameHud::Update() {
+  bool frames = interval_.count > 0;
+  char buffer[64];
+  lines_[0].SetText("Frame " + FormatMs(interval_.GetAverageMs(), frames) +
+      " max " + FormatMs(interval_.GetMaxMs(), frames) + " ms");
+  lines_[1].SetText("CPU " + FormatMs(cpu_.GetAverageMs(), cpu_.count > 0) +
+      " GPU " + FormatMs(gpu_.GetAverageMs(), gpu_.count > 0) + " ms");
+  lines_[2].SetText("Upload " + FormatMs(upload_.GetAverageMs(), upload_.count > 0) +
+      " GPU " + FormatMs(gpu_upload_.GetAverageMs(), gpu_upload_.count > 0) + " ms");
+  snprintf(buffer, sizeof(buffer), " ms, drops %llu",
+      static_cast<unsigned long long>(dropped_video_));
+  lines_[3].SetText("Pose " + FormatMs(pose_age_.GetMaxMs(), pose_age_.count > 0) + buffer);
+
+  frame_graph_.AddValue(interval_.GetMaxMs() / kGraphFrameMs);
+  drops_graph_.AddValue(dropped_video_ / kGraphDrops);
+  Clear();
+}
+
+void FrameHud::SetVisible(bool visible) {
+  visible_ = visible;
+  for (auto& l: lines_) {
+    l.SetVisible(visible);
+  }
+  frame_graph_.SetVisible(visible);
+  drops_graph_.SetVisible(visible);
+}
+
+void FrameHud::TakeChangedCells(std::vector<OverlayCell>& cells, size_t xpos, size_t ypos) {
+  for (auto& l: lines_) {
+    l.TakeChangedCells(cells, xpos, ypos);
+  }
+  frame_graph_.TakeChangedCells(cells, xpos, ypos);
+  drops_graph_.TakeChangedCells(cells, xpos, ypos);
+}
+
+void FrameHud::Clear() {
+  for (auto a: {&interval_, &cpu_, &gpu_, &upload_, &gpu_upload_, &pose_age_}) {
+    a->sum = 0;
+    a->max = 0;
+    a->count = 0;
+  }
+  dropped_video_ = 0;
+}
@@ -0,0 +1,136 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "frame_log.h"
+
+#include <cstdio>
+
+namespace {
+
+const char kCsvHeader[] = "frame,time_us,interval_us,cpu_us,upload_us,swap_us,"
+    "gpu_upload_us,gpu_left_eye_us,gpu_right_eye_us,gpu_resolve_us,gpu_overlay_us,"
+    "gpu_frame_us,pose_age_us,dropped_video,eye_scale\n";
+
+} // namespace
+
+
+uint64_t GetGpuFrameTime(const FrameRecord& record) {
+  uint64_t total = 0;
+  for (auto t: record.gpu_us) {
+    total += t;
+  }
+  return total;
+}
+
+
+FrameLog::FrameLog(): stop_(false), lost_(0) {
+}
+
+FrameLog::~FrameLog() {
+  Close();
+}
+
+bool FrameLog::Open(const std::string& fname) {
+  Close();
+  file_.open(fname, std::ios::out | std::ios::trunc);
+  if (!file_) {
+    return false;
+  }
+  file_ << kCsvHeader;
+
+  queue_.reserve(kMaxQueued);
+  stop_ = false;
+  lost_ = 0;
+  std::thread wthr(&FrameLog::WriteRecords, this);
+  std::swap(writer_, wthr);
+  return true;
+}
+
+void FrameLog::Close() {
+  if (writer_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lk(lock_);
+      stop_ = true;
+    }
+    cv_.notify_one();
+    writer_.join();
+    if (lost_ > 0) {
+      printf("Frame log: %llu records are lost\n", static_cast<unsigned long long>(lost_));
+    }
+  }
+  if (file_.is_open()) {
+    file_.close();
+  }
+}
+
+void FrameLog::Write(const FrameRecord& record) {
+  bool wake;
+  {
+    std::lock_guard<std::mutex> lk(lock_);
+    if (!writer_.joinable() || queue_.size() >= kMaxQueued) {
+      ++lost_;
+      return;
+    }
+    // The writer sleeps only on empty queue
+    wake = queue_.empty();
+    queue_.push_back(record);
+  }
+  if (wake) {
+    cv_.notify_one();
+  }
+}
+
+void FrameLog::WriteRecords() {
+  std::vector<FrameRecord> records;
+  records.reserve(kMaxQueued);
+  char line[256];
+  bool stop = false;
+  while (!stop) {
+    {
+      std::unique_lock<std::mutex> lk(lock_);
+      cv_.wait(lk, [this](){ return stop_ || !queue_.empty(); });
+      records.swap(queue_);
+      stop = stop_;
+    }
+
+    for (auto& r: records) {
+      int len = snprintf(line, sizeof(line), "%llu,%llu,%llu,%llu,%llu,%llu,",
+          static_cast<unsigned long long>(r.frame), static_cast<unsigned long long>(r.time_us),
+          static_cast<unsigned long long>(r.interval_us), static_cast<unsigned long long>(r.cpu_us),
+          static_cast<unsigned long long>(r.upload_us), static_cast<unsigned long long>(r.swap_us));
+      // Unknown GPU times are left empty
+      if (r.gpu_valid) {
+        for (auto t: r.gpu_us) {
+          len += snprintf(line + len, sizeof(line) - len, "%llu,", static_cast<unsigned long long>(t));
+        }
+        len += snprintf(line + len, sizeof(line) - len, "%llu,",
+            static_cast<unsigned long long>(GetGpuFrameTime(r)));
+      } else {
+        for (size_t i = 0; i <= kGpuStageCount; ++i) {
+          line[len++] = ',';
+        }
+      }
+      snprintf(line + len, sizeof(line) - len, "%llu,%llu,%.2f\n",
+          static_cast<unsigned long long>(r.pose_age_us),
+          static_cast<unsigned long long>(r.dropped_video), r.eye_scale);
+      file_ << line;
+    }
+    records.clear();
+  }
+  file_.flush();
+}
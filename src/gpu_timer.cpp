@@ -0,0 +1,166 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "gpu_timer.h"
+
+#include <cstdio>
+
+#include <QOpenGLContext>
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT 0x8866
+#endif
+
+#ifndef GL_QUERY_RESULT_AVAILABLE
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+
+namespace {
+
+const char* const kStageNames[kGpuStageCount] = {
+    "Upload", "Left eye", "Right eye", "Resolve", "Overlay"};
+
+} // namespace
+
+
+GpuTimer::GpuTimer(): gl_(nullptr), supported_(false), current_(0), active_(-1), dropped_(0) {
+  for (auto& f: frames_) {
+    for (size_t i = 0; i < kGpuStageCount; ++i) {
+      f.queries[i] = 0;
+      f.used[i] = false;
+    }
+  }
+  for (auto& t: last_) {
+    t = 0;
+  }
+}
+
+void GpuTimer::Initialize() {
+  auto context = QOpenGLContext::currentContext();
+  if (!context) {
+    return;
+  }
+  // GL_TIME_ELAPSED входит в OpenGL 3.3
+  auto format = context->format();
+  supported_ = format.majorVersion() > 3 || (format.majorVersion() == 3 && format.minorVersion() >= 3) ||
+      context->hasExtension("GL_ARB_timer_query");
+  if (!supported_) {
+    printf("GPU timing is disabled: the driver doesn't support timer queries\n");
+    return;
+  }
+
+  gl_ = context->extraFunctions();
+  for (auto& f: frames_) {
+    gl_->glGenQueries(kGpuStageCount, f.queries);
+  }
+}
+
+void GpuTimer::Destroy() {
+  if (!supported_) {
+    return;
+  }
+  for (auto& f: frames_) {
+    gl_->glDeleteQueries(kGpuStageCount, f.queries);
+  }
+  supported_ = false;
+}
+
+bool GpuTimer::BeginFrame() {
+  if (!supported_) {
+    return false;
+  }
+  current_ = (current_ + 1) % kFramesInFlight;
+  FrameQueries& f = frames_[current_];
+
+  // Запросы выполняются по порядку: если готов последний, то готовы все
+  int last = -1;
+  for (int i = 0; i < kGpuStageCount; ++i) {
+    if (f.used[i]) {
+      last = i;
+    }
+  }
+  bool ready = false;
+  if (last >= 0) {
+    GLuint available = 0;
+    gl_->glGetQueryObjectuiv(f.queries[last], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available) {
+      uint64_t total = 0;
+      for (int i = 0; i < kGpuStageCount; ++i) {
+        last_[i] = 0;
+        if (!f.used[i]) {
+          continue;
+        }
+        // Результат в наносекундах. 32 бит хватает на 4 секунды
+        GLuint time_ns = 0;
+        gl_->glGetQueryObjectuiv(f.queries[i], GL_QUERY_RESULT, &time_ns);
+        last_[i] = time_ns / 1000;
+        stages_[i].Record(last_[i]);
+        total += time_ns / 1000;
+      }
+      frames_time_.Record(total);
+      ready = true;
+    } else {
+      ++dropped_;
+    }
+  }
+  for (auto& u: f.used) {
+    u = false;
+  }
+  return ready;
+}
+
+void GpuTimer::BeginStage(GpuStage stage) {
+  if (!supported_ || active_ >= 0) {
+    return;
+  }
+  gl_->glBeginQuery(GL_TIME_ELAPSED, frames_[current_].queries[stage]);
+  frames_[current_].used[stage] = true;
+  active_ = stage;
+}
+
+void GpuTimer::EndStage() {
+  if (active_ < 0) {
+    return;
+  }
+  gl_->glEndQuery(GL_TIME_ELAPSED);
+  active_ = -1;
+}
+
+void GpuTimer::AddSwapTime(uint64_t time_us) {
+  swap_.Record(time_us);
+}
+
+std::string GpuTimer::Format() const {
+  std::string res;
+  if (supported_) {
+    for (int i = 0; i < kGpuStageCount; ++i) {
+      if (stages_[i].GetCount() > 0) {
+        res += std::string("GPU ") + kStageNames[i] + ": " + stages_[i].Format() + "\n";
+      }
+    }
+    res += "GPU frame: " + frames_time_.Format() + "\n";
+  }
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "Not ready GPU results: %llu\n",
+      static_cast<unsigned long long>(dropped_));
+  return res + "Swap wait (CPU): " + swap_.Format() + "\n" + buffer;
+}
@@ -0,0 +1,567 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "hmd_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <QFile>
+#include <QOpenGLContext>
+#include <QOpenGLPixelTransferOptions>
+
+#ifndef GL_ONE_MINUS_SRC1_COLOR
+#define GL_ONE_MINUS_SRC1_COLOR 0x88FA
+#endif
+
+HmdRenderer::HmdRenderer(const QString& cache_directory, QObject* parent): gl_(nullptr),
+    program_cache_(cache_directory),
+    sphere_shaders_(":/shader/sphere.vert", ":/shader/sphere.frag",
+    {"CYLINDER_SCREEN", "FULL_SPHERE", "DEBUG_DISTORSION"}, {"vertex_attr"}, &program_cache_, parent),
+    overlay_shaders_(":/shader/overlay.vert", ":/shader/overlay.frag", {"PREMULTIPLY"},
+    {"info_pos_attr", "uv_attr", "uv_rect_attr", "uv_scale_attr"}, &program_cache_, parent),
+    screen_vbo_(QOpenGLBuffer::VertexBuffer), screen_ibo_(QOpenGLBuffer::IndexBuffer),
+    video_tex_(nullptr), fov_(80.0f), video_angle_(360), video_projection_mode_(Monoscopic),
+    invert_stereo_(false), rgb_workaround_(false), cylinder_screen_(false), debug_distortion_(false),
+    overlay_vbo_(QOpenGLBuffer::VertexBuffer), cells_vbo_(QOpenGLBuffer::VertexBuffer),
+    test_screen_width_(0), test_screen_height_(0), overlay_changed_(true), cells_used_(0) {
+  eye_scale_ = 1.0f;
+  eyes_disp_ = 0.0f;
+  horizont_level_ = 0.0f;
+  test_screen_quad_ = OverlayQuad{kTestScreenTexture, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+  for (auto& r: overlay_ranges_) {
+    r.first = 0;
+    r.count = 0;
+  }
+  for (auto& a: overlay_atlases_) {
+    a = OverlayAtlas{0, 0, nullptr};
+  }
+
+  GenerateDistortionMesh(kMeshLines, kMeshHalfSize, screen_mesh_);
+}
+
+HmdRenderer::~HmdRenderer() {
+  delete video_tex_;
+}
+
+void HmdRenderer::SetTestScreenFile(const QString& fname, size_t width, size_t height) {
+  test_screen_file_ = fname;
+  test_screen_width_ = width;
+  test_screen_height_ = height;
+}
+
+void HmdRenderer::SetOverlay(const std::vector<OverlayQuad>& quads) {
+  std::lock_guard<std::mutex> lk(overlay_lock_);
+  overlay_quads_ = quads;
+  overlay_changed_ = true;
+}
+
+void HmdRenderer::UpdateOverlayCells(const std::vector<OverlayCell>& cells) {
+  std::lock_guard<std::mutex> lk(overlay_lock_);
+  overlay_cells_.insert(overlay_cells_.end(), cells.begin(), cells.end());
+}
+
+void HmdRenderer::Initialize() {
+  gl_ = QOpenGLContext::currentContext()->extraFunctions();
+
+  // Номер атрибута вершин одинаков во всех вариантах шейдера, массив вершин
+  // настраивается по любому из них
+  auto sphere_shader = sphere_shaders_.Get(0);
+  sphere_shader->bind();
+
+  screen_vbo_.create();
+  screen_vbo_.bind();
+  screen_vbo_.setUsagePattern(QOpenGLBuffer::StaticDraw);
+  screen_vbo_.allocate(screen_mesh_.vertices.data(), screen_mesh_.vertices.size() * sizeof(float));
+
+  screen_vao_.create();
+  screen_vao_.bind();
+  sphere_shader->enableAttributeArray(0);
+  sphere_shader->setAttributeBuffer(0, GL_FLOAT, 0, 3);
+  // Буфер индексов запоминается в массиве вершин
+  screen_ibo_.create();
+  screen_ibo_.bind();
+  screen_ibo_.setUsagePattern(QOpenGLBuffer::StaticDraw);
+  screen_ibo_.allocate(screen_mesh_.indices.data(), screen_mesh_.indices.size() * sizeof(uint16_t));
+  sphere_shader->release();
+  screen_vao_.release();
+  screen_vbo_.release();
+
+  video_tex_ = new QOpenGLTexture(QOpenGLTexture::Target2D);
+  video_tex_->create();
+  video_tex_->setFormat(QOpenGLTexture::RGB8_UNorm);
+  video_tex_->setSize(1, 1);
+  video_tex_->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+  video_tex_->allocateStorage(rgb_workaround_ ? QOpenGLTexture::BGR : QOpenGLTexture::RGB, QOpenGLTexture::PixelType::UInt8);
+  video_tex_->bind();
+  unsigned char data[3] = { 0, 0, 0};
+  video_tex_->setData(rgb_workaround_ ? QOpenGLTexture::BGR : QOpenGLTexture::RGB, QOpenGLTexture::PixelType::UInt8, (const void *)data);
+
+  InitializeOverlay();
+  gpu_timer_.Initialize();
+}
+
+void HmdRenderer::Destroy() {
+  gpu_timer_.Destroy();
+  eye_fbo_.reset();
+  delete video_tex_;
+  video_tex_ = nullptr;
+}
+
+bool HmdRenderer::BeginFrame() {
+  return gpu_timer_.BeginFrame();
+}
+
+void HmdRenderer::UploadVideo(const VideoDataInfoPtr& frame) {
+  // Этап измеряется и без кадра, чтобы время этапов кадра было полным
+  gpu_timer_.BeginStage(kGpuUpload);
+  if (frame) {
+    UploadVideoTexture(*frame);
+  }
+  gpu_timer_.EndStage();
+}
+
+void HmdRenderer::UploadVideoTexture(VideoDataInfo& frame) {
+  if (video_tex_->width() != static_cast<int>(frame.GetWidth()) ||
+      video_tex_->height() != static_cast<int>(frame.GetHeight())) {
+    if (video_tex_->isStorageAllocated()) {
+      video_tex_->destroy();
+      video_tex_->create();
+    }
+    video_tex_->setFormat(QOpenGLTexture::RGB8_UNorm);
+    video_tex_->setSize(frame.GetWidth(), frame.GetHeight());
+    video_tex_->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+    video_tex_->allocateStorage(rgb_workaround_ ? QOpenGLTexture::BGR : QOpenGLTexture::RGB, QOpenGLTexture::PixelType::UInt8);
+  }
+
+  video_tex_->bind();
+  video_tex_->setData(rgb_workaround_ ? QOpenGLTexture::BGR : QOpenGLTexture::RGB, QOpenGLTexture::PixelType::UInt8, frame.GetData());
+}
+
+void HmdRenderer::RenderEyes(int width, int height, const QMatrix4x4& model_view) {
+  // При масштабе 1 глаза рисуются прямо в область при любой её ширине.
+  // Ширина буфера глаз чётная, чтобы глаза делили его поровну
+  float scale = eye_scale_;
+  bool scaled = std::fabs(scale - 1.0f) > kEyeScaleTolerance;
+  int eye_width = width;
+  int eye_height = height;
+  GLint target = 0;
+  if (scaled) {
+    eye_width = std::max(kMinEyeBufferSize, static_cast<int>(width * scale * 0.5f + 0.5f) * 2);
+    eye_height = std::max(kMinEyeBufferSize, static_cast<int>(height * scale + 0.5f));
+    // Буфер кадра виджета не нулевой, поэтому запоминается текущий
+    gl_->glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+    if (!eye_fbo_ || eye_fbo_->size() != QSize(eye_width, eye_height)) {
+      eye_fbo_.reset(new QOpenGLFramebufferObject(eye_width, eye_height));
+    }
+    eye_fbo_->bind();
+  } else {
+    eye_fbo_.reset();
+  }
+
+  gl_->glClear(GL_COLOR_BUFFER_BIT);
+  gl_->glEnable(GL_CULL_FACE);
+  gl_->glDisable(GL_DEPTH_TEST);
+
+  // Оба глаза рисуются с одним положением
+  gpu_timer_.BeginStage(kGpuLeftEye);
+  RenderEye(0, eye_width, eye_height, model_view);
+  gpu_timer_.EndStage();
+  gpu_timer_.BeginStage(kGpuRightEye);
+  RenderEye(1, eye_width, eye_height, model_view);
+  gpu_timer_.EndStage();
+
+  if (scaled) {
+    gpu_timer_.BeginStage(kGpuResolve);
+    ResolveEyes(eye_width, eye_height, width, height, target);
+    gpu_timer_.EndStage();
+  }
+}
+
+void HmdRenderer::ResolveEyes(int eye_width, int eye_height, int width, int height, GLuint target) {
+  // Линейная фильтрация смешивает глаза только в столбце на стыке, где
+  // линзы всё равно показывают чёрное поле
+  gl_->glBindFramebuffer(GL_READ_FRAMEBUFFER, eye_fbo_->handle());
+  gl_->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+  gl_->glBlitFramebuffer(0, 0, eye_width, eye_height, 0, 0, width, height,
+      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  gl_->glBindFramebuffer(GL_FRAMEBUFFER, target);
+}
+
+void HmdRenderer::RenderOverlay(int width, int height) {
+  gpu_timer_.BeginStage(kGpuOverlay);
+  UpdateOverlayVertices();
+  UpdateOverlayCellVertices();
+  DrawOverlay(width, height);
+  gpu_timer_.EndStage();
+}
+
+void HmdRenderer::RenderEye(int eye, int width, int height, const QMatrix4x4& model_view) {
+  float eyedisp = eyes_disp_;
+  if (eye) {
+    eyedisp = -eyedisp;
+  }
+
+  gl_->glViewport(eye == 1 ? width / 2 : 0, 0, width / 2, height);
+
+  unsigned features = 0;
+  if (cylinder_screen_) {
+    features |= kCylinderScreenFeature;
+  } else if (video_angle_ == 360) {
+    features |= kFullSphereFeature;
+  }
+  if (debug_distortion_) {
+    features |= kDebugDistortionFeature;
+  }
+  auto sphere_shader = sphere_shaders_.Get(features);
+  sphere_shader->bind();
+
+  QMatrix4x4 view = model_view;
+  view.translate(eyedisp, horizont_level_, 0.0f);
+
+  QMatrix4x4 projection_matrix;
+  sphere_shader->setUniformValue("modelview_projection_uni", view * projection_matrix);
+
+  sphere_shader->setUniformValue("tex_uni", 0);
+  sphere_shader->setUniformValue("vertex_x_disp", eyedisp);
+  video_tex_->bind(0);
+
+  int eye_inv = invert_stereo_ ? eye : 1 - eye;
+
+  switch (video_projection_mode_) {
+    case Monoscopic:
+      sphere_shader->setUniformValue("min_max_uv_uni", 0.0f, 0.0f, 1.0f, 1.0f);
+      break;
+    case OverUnder:
+      if (eye_inv == 1)
+        sphere_shader->setUniformValue("min_max_uv_uni", 0.0f, 0.5f, 1.0f, 1.0f);
+      else
+        sphere_shader->setUniformValue("min_max_uv_uni", 0.0f, 0.0f, 1.0f, 0.5f);
+      break;
+    case SideBySide:
+      if (eye_inv == 1)
+        sphere_shader->setUniformValue("min_max_uv_uni", 0.0f, 0.0f, 0.5f, 1.0f);
+      else
+        sphere_shader->setUniformValue("min_max_uv_uni", 0.5f, 0.0f, 1.0f, 1.0f);
+      break;
+  }
+
+  sphere_shader->setUniformValue("projection_angle_factor_uni", 360.0f / (float)video_angle_);
+
+  screen_vao_.bind();
+  gl_->glDrawElements(GL_TRIANGLES, screen_mesh_.indices.size(), GL_UNSIGNED_SHORT, nullptr);
+  screen_vao_.release();
+  sphere_shader->release();
+}
+
+void HmdRenderer::InitializeOverlay()
+{
+  overlay_vbo_.create();
+  overlay_vbo_.bind();
+  overlay_vbo_.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+  overlay_vbo_.release();
+  SetupOverlayAttributes(overlay_vbo_, overlay_vao_);
+
+  // Место под все ячейки выделяется сразу, ячейки затем обновляются по одной
+  std::vector<float> empty(kOverlayCellCount * kCellVertices * kOverlayVertexSize, 0.0f);
+  cells_vbo_.create();
+  cells_vbo_.bind();
+  cells_vbo_.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+  cells_vbo_.allocate(empty.data(), empty.size() * sizeof(float));
+  cells_vbo_.release();
+  SetupOverlayAttributes(cells_vbo_, cells_vao_);
+
+  LoadTestScreen();
+  for (int kind = kSpriteAtlasTexture; kind < kOverlayTextureCount; ++kind) {
+    auto& atlas = overlay_atlases_[kind];
+    TileRect rect = {0, 0, atlas.width, atlas.height};
+    CreateOverlayTexture(static_cast<OverlayTexture>(kind), atlas.pixels, atlas.width, rect);
+  }
+}
+
+void HmdRenderer::SetupOverlayAttributes(QOpenGLBuffer& vbo, QOpenGLVertexArrayObject& vao)
+{
+  vao.create();
+  vao.bind();
+  vbo.bind();
+  auto overlay_shader = overlay_shaders_.Get(0);
+  overlay_shader->bind();
+  const int stride = kOverlayVertexSize * sizeof(float);
+  overlay_shader->enableAttributeArray(0);
+  overlay_shader->setAttributeBuffer(0, GL_FLOAT, 0, 2, stride);
+  overlay_shader->enableAttributeArray(1);
+  overlay_shader->setAttributeBuffer(1, GL_FLOAT, 2 * sizeof(float), 2, stride);
+  overlay_shader->enableAttributeArray(2);
+  overlay_shader->setAttributeBuffer(2, GL_FLOAT, 4 * sizeof(float), 4, stride);
+  overlay_shader->enableAttributeArray(3);
+  overlay_shader->setAttributeBuffer(3, GL_FLOAT, 8 * sizeof(float), 2, stride);
+  overlay_shader->release();
+  vao.release();
+  vbo.release();
+}
+
+void HmdRenderer::LoadTestScreen()
+{
+  if (test_screen_file_.isEmpty() || test_screen_width_ == 0 || test_screen_height_ == 0) {
+    return;
+  }
+
+  // Файл не копируется в память: он отображается на время загрузки текстуры
+  QFile f(test_screen_file_);
+  qint64 size = test_screen_width_ * test_screen_height_ * sizeof(uint32_t);
+  if (!f.open(QIODevice::ReadOnly) || f.size() < size) {
+    return;
+  }
+  uchar* mapped = f.map(0, size);
+  if (!mapped) {
+    return;
+  }
+  const uint32_t* data = reinterpret_cast<const uint32_t*>(mapped);
+
+  // Ищем область с непрозрачными пикселями. Обычно это малая часть поля
+  size_t left = test_screen_width_;
+  size_t top = test_screen_height_;
+  size_t right = 0;
+  size_t bottom = 0;
+  for (size_t i = 0; i < test_screen_height_; ++i) {
+    const uint32_t* row = data + i * test_screen_width_;
+    for (size_t j = 0; j < test_screen_width_; ++j) {
+      if (row[j] >> 24) {
+        left = std::min(left, j);
+        right = std::max(right, j + 1);
+        top = std::min(top, i);
+        bottom = i + 1;
+      }
+    }
+  }
+
+  if (right > left && bottom > top) {
+    TileRect rect = {left, top, right - left, bottom - top};
+    CreateOverlayTexture(kTestScreenTexture, data, test_screen_width_, rect);
+    test_screen_quad_ = OverlayQuad{kTestScreenTexture,
+        static_cast<float>(left), static_cast<float>(top),
+        static_cast<float>(rect.width), static_cast<float>(rect.height), 0.0f, 0.0f,
+        static_cast<float>(rect.width), static_cast<float>(rect.height)};
+  }
+  f.unmap(mapped);
+}
+
+void HmdRenderer::CreateOverlayTexture(OverlayTexture kind, const uint32_t* data, size_t stride,
+    const TileRect& rect)
+{
+  if (!data || rect.width == 0 || rect.height == 0) {
+    return;
+  }
+
+  // Текстуры наложения неизменны: загружаются один раз при инициализации
+  std::shared_ptr<QOpenGLTexture> tex(new QOpenGLTexture(QOpenGLTexture::Target2D));
+  tex->create();
+  tex->setFormat(QOpenGLTexture::RGBA8_UNorm);
+  tex->setSize(rect.width, rect.height);
+  tex->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+  tex->setWrapMode(QOpenGLTexture::ClampToEdge);
+  tex->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::PixelType::UInt8);
+  // Загружается только область rect, данные читаются прямо из источника
+  QOpenGLPixelTransferOptions options;
+  options.setAlignment(4);
+  options.setRowLength(stride);
+  options.setSkipPixels(rect.x);
+  options.setSkipRows(rect.y);
+  tex->setData(QOpenGLTexture::RGBA, QOpenGLTexture::PixelType::UInt8, data, &options);
+  overlay_tex_[kind] = tex;
+}
+
+void HmdRenderer::UpdateOverlayVertices()
+{
+  std::vector<OverlayQuad> quads;
+  {
+    std::lock_guard<std::mutex> lk(overlay_lock_);
+    if (!overlay_changed_) {
+      return;
+    }
+    quads = overlay_quads_;
+    overlay_changed_ = false;
+  }
+
+  // Вершины группируются по текстурам: тестовый экран рисуется первым
+  std::vector<float> vertices;
+  for (int kind = 0; kind < kOverlayTextureCount; ++kind) {
+    auto& range = overlay_ranges_[kind];
+    range.first = vertices.size() / kOverlayVertexSize;
+    auto tex = overlay_tex_[kind];
+    if (tex) {
+      if (kind == kTestScreenTexture) {
+        AddOverlayQuadVertices(vertices, test_screen_quad_, tex->width(), tex->height());
+      }
+      for (auto& q: quads) {
+        if (q.texture == kind) {
+          AddOverlayQuadVertices(vertices, q, tex->width(), tex->height());
+        }
+      }
+    }
+    range.count = vertices.size() / kOverlayVertexSize - range.first;
+  }
+
+  if (vertices.empty()) {
+    return;
+  }
+  overlay_vbo_.bind();
+  overlay_vbo_.allocate(vertices.data(), vertices.size() * sizeof(float));
+  overlay_vbo_.release();
+}
+
+void HmdRenderer::UpdateOverlayCellVertices()
+{
+  std::vector<OverlayCell> cells;
+  {
+    std::lock_guard<std::mutex> lk(overlay_lock_);
+    cells.swap(overlay_cells_);
+  }
+  auto tex = overlay_tex_[kGlyphAtlasTexture];
+  if (cells.empty() || !tex) {
+    return;
+  }
+
+  // Каждая ячейка рисуется одним прямоугольником. Скрытая ячейка заполняется
+  // нулями: её треугольники вырождены и не рисуются
+  const size_t cell_floats = kCellVertices * kOverlayVertexSize;
+  std::vector<float> vertices;
+  cells_vbo_.bind();
+  for (auto& cell: cells) {
+    if (cell.index >= kOverlayCellCount) {
+      continue;
+    }
+    vertices.clear();
+    AddOverlayQuadVertices(vertices, cell.quad, tex->width(), tex->height(),
+        std::numeric_limits<float>::max());
+    cells_visible_[cell.index] = !vertices.empty();
+    vertices.resize(cell_floats, 0.0f);
+    cells_vbo_.write(cell.index * cell_floats * sizeof(float), vertices.data(),
+        cell_floats * sizeof(float));
+  }
+  cells_vbo_.release();
+
+  // Скрытые ячейки в конце не рисуются. Если скрыты все, проход наложения
+  // для них не выполняется
+  cells_used_ = kOverlayCellCount;
+  while (cells_used_ > 0 && !cells_visible_[cells_used_ - 1]) {
+    --cells_used_;
+  }
+}
+
+void HmdRenderer::AddOverlayQuadVertices(std::vector<float>& vertices, const OverlayQuad& quad,
+    float tex_width, float tex_height, float cell_size)
+{
+  if (quad.width <= 0.0f || quad.height <= 0.0f) {
+    return;
+  }
+
+  // Область картинки в текстуре и изменение текстурных координат на единицу
+  // координат поля информации (поле от -1 до +1)
+  const float half_width = kOverlayWidth / 2.0f;
+  const float half_height = kOverlayHeight / 2.0f;
+  float scale_u = quad.tex_width / quad.width * half_width / tex_width;
+  float scale_v = quad.tex_height / quad.height * half_height / tex_height;
+  float uv_rect[4] = {quad.u / tex_width, quad.v / tex_height,
+      (quad.u + quad.tex_width) / tex_width, (quad.v + quad.tex_height) / tex_height};
+
+  // Прямоугольник расширяется на kOverlayMargin, чтобы смещённые зелёный и
+  // синий цвета не обрезались. За пределами картинки шейдер выдаёт прозрачность
+  float left = quad.x - kOverlayMargin;
+  float top = quad.y - kOverlayMargin;
+  float right = quad.x + quad.width + kOverlayMargin;
+  float bottom = quad.y + quad.height + kOverlayMargin;
+
+  // Дисторсия корректируется по вершинам, поэтому большие прямоугольники
+  // разбиваются на ячейки
+  int xcells = std::max<int>(1, std::ceil((right - left) / cell_size));
+  int ycells = std::max<int>(1, std::ceil((bottom - top) / cell_size));
+  auto add_vertex = [&](float x, float y) {
+    vertices.push_back(x / half_width - 1.0f);
+    vertices.push_back(y / half_height - 1.0f);
+    vertices.push_back((quad.u + (x - quad.x) * quad.tex_width / quad.width) / tex_width);
+    vertices.push_back((quad.v + (y - quad.y) * quad.tex_height / quad.height) / tex_height);
+    vertices.insert(vertices.end(), uv_rect, uv_rect + 4);
+    vertices.push_back(scale_u);
+    vertices.push_back(scale_v);
+  };
+  for (int i = 0; i < ycells; ++i) {
+    float y0 = top + (bottom - top) * i / ycells;
+    float y1 = top + (bottom - top) * (i + 1) / ycells;
+    for (int j = 0; j < xcells; ++j) {
+      float x0 = left + (right - left) * j / xcells;
+      float x1 = left + (right - left) * (j + 1) / xcells;
+      // Ось y поля направлена вниз, поэтому обход против часовой стрелки на экране
+      add_vertex(x0, y0);
+      add_vertex(x0, y1);
+      add_vertex(x1, y1);
+      add_vertex(x1, y1);
+      add_vertex(x1, y0);
+      add_vertex(x0, y0);
+    }
+  }
+}
+
+void HmdRenderer::DrawOverlay(int width, int height)
+{
+  bool empty = true;
+  for (auto& r: overlay_ranges_) {
+    empty = empty && r.count == 0;
+  }
+  bool draw_cells = cells_used_ > 0 && overlay_tex_[kGlyphAtlasTexture];
+  if (empty && !draw_cells) {
+    return;
+  }
+
+  // Наложение одинаково для обоих глаз: рисуем его поверх каждой половины
+  int w = width;
+  int h = height;
+  gl_->glEnable(GL_BLEND);
+  gl_->glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC1_COLOR);
+  for (int eye = 0; eye < 2; ++eye) {
+    gl_->glViewport(eye == 1 ? w/2 : 0, 0, w/2, h);
+    overlay_vao_.bind();
+    for (int kind = 0; kind < kOverlayTextureCount; ++kind) {
+      auto& range = overlay_ranges_[kind];
+      if (range.count == 0) {
+        continue;
+      }
+      // Тестовый экран хранится без предумножения прозрачности
+      auto overlay_shader = overlay_shaders_.Get(kind == kTestScreenTexture ? kPremultiplyFeature : 0);
+      overlay_shader->bind();
+      overlay_shader->setUniformValue("tex_overlay", 0);
+      overlay_tex_[kind]->bind(0);
+      gl_->glDrawArrays(GL_TRIANGLES, range.first, range.count);
+    }
+    overlay_vao_.release();
+
+    // Ячейки (экранный текст) рисуются поверх остального наложения
+    if (draw_cells) {
+      auto overlay_shader = overlay_shaders_.Get(0);
+      overlay_shader->bind();
+      overlay_shader->setUniformValue("tex_overlay", 0);
+      overlay_tex_[kGlyphAtlasTexture]->bind(0);
+      cells_vao_.bind();
+      gl_->glDrawArrays(GL_TRIANGLES, 0, cells_used_ * kCellVertices);
+      cells_vao_.release();
+    }
+  }
+  overlay_shaders_.Get(0)->release();
+  gl_->glDisable(GL_BLEND);
+}
@@ -18,367 +18,139 @@
 
 #include "hmdwidget.h"
 
+#include <cstdio>
+
+#include <QScreen>
+#include <QStandardPaths>
+#include <QWindow>
+
 HMDWidget::HMDWidget(VideoPlayer *video_player, PsvrSensors *psvr, QWidget *parent):
-  QOpenGLWidget(parent), cylinder_screen_(false), force_update_info_(false)
+  QOpenGLWidget(parent),
+  renderer_(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/shaders", this),
+  painted_sequence_(0), frame_hud_(nullptr), frame_count_(0), dropped_video_(0)
 {
 	this->video_player = video_player;
 	this->psvr = psvr;
 
-	gl = 0;
-	//fbo = 0;
-
-	sphere_shader = 0;
-	distortion_shader = 0;
-  video_tex = nullptr;
-  info_texture_data_.resize(kInfoHeight * kInfoWidth);
-  info_texture_array_ = (InfoTextureRow*)info_texture_data_.data();
-
-	fov = 80.0f;
-
-  eyes_disp_ = 0.0f;
-
-	video_angle = 360;
-	video_projection_mode = Monoscopic;
-	invert_stereo = false;
-
-	rgb_workaround = false;
+  for (auto& r: frame_records_) {
+    r = FrameRecord();
+  }
 
-  GenerateFlatVertices();
+  connect(this, SIGNAL(frameSwapped()), this, SLOT(OnFrameSwapped()));
 }
 
 HMDWidget::~HMDWidget()
 {
-	delete video_tex;
-  //delete fbo;
+  printf("Rendering statistics:\n%s", renderer_.GetGpuTimer().Format().c_str());
+  makeCurrent();
+  renderer_.Destroy();
+  doneCurrent();
 }
 
-void HMDWidget::SetCylinderScreen(bool value) {
-  cylinder_screen_ = value;
+void HMDWidget::SetEyeScaleBounds(float min_scale, float max_scale)
+{
+  governor_.SetBounds(min_scale, max_scale);
+  renderer_.SetEyeScale(governor_.GetScale());
 }
 
-
-static const QVector3D cube_vertices[] = {
-		// back
-		QVector3D(-1.0f,  1.0f, -1.0f),
-		QVector3D(-1.0f, -1.0f, -1.0f),
-		QVector3D( 1.0f, -1.0f, -1.0f),
-
-		QVector3D( 1.0f, -1.0f, -1.0f),
-		QVector3D( 1.0f,  1.0f, -1.0f),
-		QVector3D(-1.0f,  1.0f, -1.0f),
-
-		// front
-		QVector3D( 1.0f,  1.0f,  1.0f),
-		QVector3D( 1.0f, -1.0f,  1.0f),
-		QVector3D(-1.0f, -1.0f,  1.0f),
-
-		QVector3D(-1.0f, -1.0f,  1.0f),
-		QVector3D(-1.0f,  1.0f,  1.0f),
-		QVector3D( 1.0f,  1.0f,  1.0f),
-
-		// left
-		QVector3D(-1.0f,  1.0f,  1.0f),
-		QVector3D(-1.0f, -1.0f,  1.0f),
-		QVector3D(-1.0f, -1.0f, -1.0f),
-
-		QVector3D(-1.0f, -1.0f, -1.0f),
-		QVector3D(-1.0f,  1.0f, -1.0f),
-		QVector3D(-1.0f,  1.0f,  1.0f),
-
-		// right
-		QVector3D( 1.0f,  1.0f, -1.0f),
-		QVector3D( 1.0f, -1.0f, -1.0f),
-		QVector3D( 1.0f, -1.0f,  1.0f),
-
-		QVector3D( 1.0f, -1.0f,  1.0f),
-		QVector3D( 1.0f,  1.0f,  1.0f),
-		QVector3D( 1.0f,  1.0f, -1.0f),
-
-		// top
-		QVector3D(-1.0f,  1.0f, -1.0f),
-		QVector3D( 1.0f,  1.0f, -1.0f),
-		QVector3D( 1.0f,  1.0f,  1.0f),
-
-		QVector3D( 1.0f,  1.0f,  1.0f),
-		QVector3D(-1.0f,  1.0f,  1.0f),
-		QVector3D(-1.0f,  1.0f, -1.0f),
-
-		// bottom
-		QVector3D( 1.0f, -1.0f, -1.0f),
-		QVector3D(-1.0f, -1.0f, -1.0f),
-		QVector3D(-1.0f, -1.0f,  1.0f),
-
-		QVector3D(-1.0f, -1.0f,  1.0f),
-		QVector3D( 1.0f, -1.0f,  1.0f),
-		QVector3D( 1.0f, -1.0f, -1.0f)
-	};
-
-static const QVector2D screen_vertices[] = {
-		QVector2D(-1.0f,  1.0f),
-		QVector2D(-1.0f, -1.0f),
-		QVector2D( 1.0f,  1.0f),
-		QVector2D( 1.0f, -1.0f)
-	};
-
 void HMDWidget::initializeGL()
 {
-	gl = context()->functions();
-
-	sphere_shader = new QOpenGLShaderProgram(this);
-	sphere_shader->addShaderFromSourceFile(QOpenGLShader::Vertex, ":/shader/sphere.vert");
-	sphere_shader->addShaderFromSourceFile(QOpenGLShader::Fragment, ":/shader/sphere.frag");
-	sphere_shader->link();
-
-	sphere_shader->bind();
-	sphere_shader->bindAttributeLocation("vertex_attr", 0);
-
-	cube_vbo.create();
-	cube_vbo.bind();
-	cube_vbo.setUsagePattern(QOpenGLBuffer::StaticDraw);
-  cube_vbo.allocate(cube_vertices_.data(), cube_vertices_.size() * sizeof(QVector3D));
-
-	cube_vao.create();
-	cube_vao.bind();
-	sphere_shader->enableAttributeArray(0);
-	sphere_shader->setAttributeBuffer(0, GL_FLOAT, 0, 3);
-	sphere_shader->release();
-	cube_vbo.release();
-	cube_vao.release();
-
-	video_tex = new QOpenGLTexture(QOpenGLTexture::Target2D);
-	video_tex->create();
-	video_tex->setFormat(QOpenGLTexture::RGB8_UNorm);
-	video_tex->setSize(1, 1);
-	video_tex->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
-  video_tex->allocateStorage(rgb_workaround ? QOpenGLTexture::BGR : QOpenGLTexture::RGB, QOpenGLTexture::PixelType::UInt8);
-	video_tex->bind();
-	unsigned char data[3] = { 0, 0, 0};
-  video_tex->setData(rgb_workaround ? QOpenGLTexture::BGR : QOpenGLTexture::RGB, QOpenGLTexture::PixelType::UInt8, (const void *)data);
-
-  // Создадим текстуру для вывода информации
-  info_tex_.reset(new QOpenGLTexture(QOpenGLTexture::Target2D));
-  info_tex_->create();
-  info_tex_->setFormat(QOpenGLTexture::RGBA8_UNorm);
-  info_tex_->setSize(kInfoWidth, kInfoHeight);
-  info_tex_->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
-  info_tex_->allocateStorage(QOpenGLTexture::RGBA, QOpenGLTexture::PixelType::UInt8);
-  info_tex_->bind();
-  info_tex_->setData(QOpenGLTexture::RGBA, QOpenGLTexture::PixelType::UInt8, info_texture_data_.data());
-
-	/*distortion_shader = new QOpenGLShaderProgram(this);
-	distortion_shader->addShaderFromSourceFile(QOpenGLShader::Vertex, "./shader/distortion.vert");
-	distortion_shader->addShaderFromSourceFile(QOpenGLShader::Fragment, "./shader/distortion.frag");
-	distortion_shader->link();
-
-	distortion_shader->bind();
-	distortion_shader->bindAttributeLocation("vertex_attr", 0);
-
-	screen_vbo.create();
-	screen_vbo.bind();
-	screen_vbo.setUsagePattern(QOpenGLBuffer::StaticDraw);
-	screen_vbo.allocate(screen_vertices, sizeof(screen_vertices));
-
-	screen_vao.create();
-	screen_vao.bind();
-	distortion_shader->enableAttributeArray(0);
-	distortion_shader->setAttributeBuffer(0, GL_FLOAT, 0, 2);
-
-	CreateFBO(width() / 2, height());*/
+  renderer_.Initialize();
 }
 
 
 void HMDWidget::resizeGL(int w, int h)
 {
-	//CreateFBO(w / 2, h);
 	update();
 }
 
 void HMDWidget::paintGL()
 {
-	int w = width();
-	int h = height();
-
-	UpdateTexture();
-
-	gl->glClear(GL_COLOR_BUFFER_BIT);
-	gl->glEnable(GL_CULL_FACE);
-	gl->glDisable(GL_DEPTH_TEST);
-
-	/*gl->glViewport(0, 0, w, h);
-	RenderEye(0, w, h);*/
+  auto paint_start = std::chrono::steady_clock::now();
+  // Место кадра kFramesInFlight кадров назад: его время GPU готово сейчас
+  FrameRecord& record = frame_records_[frame_count_ % GpuTimer::kFramesInFlight];
+  bool gpu_ready = renderer_.BeginFrame();
+  // Время кадра должно укладываться в период обновления экрана шлема
+  auto handle = window()->windowHandle();
+  if (handle && handle->screen() && handle->screen()->refreshRate() > 1.0) {
+    governor_.SetFrameBudget(static_cast<uint64_t>(1000000.0 / handle->screen()->refreshRate()));
+  }
+  if (record.frame > 0) {
+    CompleteFrameRecord(record, gpu_ready);
+  }
+  record = FrameRecord();
+  record.frame = ++frame_count_;
+  if (record.frame == 1) {
+    first_paint_ = paint_start;
+  } else {
+    record.interval_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        paint_start - last_paint_).count();
+  }
+  record.time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+      paint_start - first_paint_).count();
+  last_paint_ = paint_start;
+  uint64_t dropped_video = video_player->GetDroppedFrames();
+  record.dropped_video = dropped_video - dropped_video_;
+  dropped_video_ = dropped_video;
+  record.eye_scale = renderer_.GetEyeScale();
+
+  renderer_.UploadVideo(video_player->GetLastScreen());
+  record.upload_us = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - paint_start).count();
+
+  // Both eyes are rendered with the same pose
+  HelmetPose pose;
+  psvr->GetPose(pose);
+  record.pose_age_us = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - pose.publish_time).count();
+  painted_sequence_ = pose.sequence;
+  if (latency_probe_) {
+    latency_probe_->Reach(kLatencyPoseRead, pose.sequence);
+  }
+  renderer_.RenderEyes(width(), height(), pose.model_view);
+  if (latency_probe_) {
+    latency_probe_->Reach(kLatencyRender, pose.sequence);
+  }
 
-	RenderEye(0);
-	RenderEye(1);
+  renderer_.RenderOverlay(width(), height());
+  paint_end_ = std::chrono::steady_clock::now();
+  record.cpu_us = std::chrono::duration_cast<std::chrono::microseconds>(
+      paint_end_ - paint_start).count();
 
   update();
 }
 
-void HMDWidget::GenerateFlatVertices() {
-  QVector3D ltf(-2.0f,  2.0f, -1.0f);
-  QVector3D lbf(-2.0f, -2.0f, -1.0f);
-  QVector3D rbf( 2.0f, -2.0f, -1.0f);
-  QVector3D rtf( 2.0f,  2.0f, -1.0f);
-
-  AddFaceToVertices(ltf, lbf, rbf, rtf); // Back
-}
-
-void HMDWidget::AddFaceToVertices(QVector3D p1, QVector3D p2, QVector3D p3, QVector3D p4)
-{
-  for (size_t i = 0; i < kTriangleFactor; ++i) {
-    for (size_t j = 0; j < kTriangleFactor; ++j) {
-      QVector3D s1 = ApproximateVertice(p1, p2, p3, p4,
-        static_cast<double>(i) / kTriangleFactor,
-        static_cast<double>(j) / kTriangleFactor);
-      QVector3D s2 = ApproximateVertice(p1, p2, p3, p4,
-        static_cast<double>(i + 1) / kTriangleFactor,
-        static_cast<double>(j) / kTriangleFactor);
-      QVector3D s3 = ApproximateVertice(p1, p2, p3, p4,
-        static_cast<double>(i + 1) / kTriangleFactor,
-        static_cast<double>(j + 1) / kTriangleFactor);
-      QVector3D s4 = ApproximateVertice(p1, p2, p3, p4,
-        static_cast<double>(i) / kTriangleFactor,
-        static_cast<double>(j + 1) / kTriangleFactor);
-      AddSquareToVertices(s1, s2, s3, s4);
-    }
+void HMDWidget::OnFrameSwapped() {
+  uint64_t swap_us = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - paint_end_).count();
+  renderer_.GetGpuTimer().AddSwapTime(swap_us);
+  // Запись выведенного кадра ещё ждёт времени GPU
+  if (frame_count_ > 0) {
+    frame_records_[(frame_count_ - 1) % GpuTimer::kFramesInFlight].swap_us = swap_us;
+  }
+  if (latency_probe_) {
+    latency_probe_->Reach(kLatencySwap, painted_sequence_);
   }
 }
 
-void HMDWidget::AddSquareToVertices(QVector3D p1, QVector3D p2, QVector3D p3, QVector3D p4)
-{
-  cube_vertices_.push_back(p1);
-  cube_vertices_.push_back(p2);
-  cube_vertices_.push_back(p3);
-  cube_vertices_.push_back(p3);
-  cube_vertices_.push_back(p4);
-  cube_vertices_.push_back(p1);
-}
-
-QVector3D HMDWidget::ApproximateVertice(QVector3D p1, QVector3D p2, QVector3D p3, QVector3D p4, float f1, float f2)
-{
-  QVector3D l = (p2 - p1) * f1 + p1;
-  QVector3D r = (p3 - p4) * f1 + p4;
-  return (r - l) * f2 + l;
-}
-
-
-/*void HMDWidget::CreateFBO(int width, int height)
+void HMDWidget::CompleteFrameRecord(FrameRecord& record, bool gpu_ready)
 {
-	delete fbo;
-	fbo = new QOpenGLFramebufferObject(width, height);
-}*/
-
-void HMDWidget::UpdateTexture()
-{
-  auto video_data = video_player->GetLastScreen();
-  if (!video_data) {
-		return;
+  record.gpu_valid = gpu_ready;
+  if (gpu_ready) {
+    for (int i = 0; i < kGpuStageCount; ++i) {
+      record.gpu_us[i] = renderer_.GetGpuTimer().GetLastTime(static_cast<GpuStage>(i));
+    }
+    // От масштаба зависят только глаза и их сведение в кадр шлема
+    uint64_t scaled_us = record.gpu_us[kGpuLeftEye] + record.gpu_us[kGpuRightEye] +
+        record.gpu_us[kGpuResolve];
+    if (governor_.AddFrame(scaled_us, GetGpuFrameTime(record) - scaled_us)) {
+      renderer_.SetEyeScale(governor_.GetScale());
+    }
   }
-
-  if(video_tex->width() != video_data->GetWidth() || video_tex->height() != video_data->GetHeight())
-	{
-		if(video_tex->isStorageAllocated())
-		{
-			video_tex->destroy();
-			video_tex->create();
-		}
-		video_tex->setFormat(QOpenGLTexture::RGB8_UNorm);
-    video_tex->setSize(video_data->GetWidth(), video_data->GetHeight());
-		video_tex->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
-    video_tex->allocateStorage(rgb_workaround ? QOpenGLTexture::BGR : QOpenGLTexture::RGB, QOpenGLTexture::PixelType::UInt8);
-	}
-
-	video_tex->bind();
-  video_tex->setData(rgb_workaround ? QOpenGLTexture::BGR : QOpenGLTexture::RGB, QOpenGLTexture::PixelType::UInt8, video_data->GetData());
-  if (force_update_info_) {
-    force_update_info_ = false;
-    info_tex_->bind();
-    info_tex_->setData(QOpenGLTexture::RGBA, QOpenGLTexture::PixelType::UInt8, info_texture_data_.data());
+  if (frame_log_) {
+    frame_log_->Write(record);
   }
-}
-
-void HMDWidget::RenderEye(int eye)
-{
-	int w = width();
-	int h = height();
-
-	//fbo->bind();
-	//gl->glViewport(0, 0, w/2, h);
-	//gl->glClear(GL_COLOR_BUFFER_BIT);
-
-  float eyedisp = eyes_disp_;
-  if (eye) {
-    eyedisp = -eyedisp;
+  if (frame_hud_ && frame_hud_->IsVisible()) {
+    frame_hud_->AddFrame(record);
   }
-
-	gl->glViewport(eye == 1 ? w/2 : 0, 0, w/2, h);
-
-
-
-	sphere_shader->bind();
-
-  QMatrix4x4 view;
-  psvr->GetModelViewMatrix(view);
-  view.translate(eyedisp, horizont_level_, 0.0f);
-
-
-	QMatrix4x4 projection_matrix;
-//  projection_matrix.ortho(-1, 1, -1, 1, 0, -2);
-//	projection_matrix.perspective(fov, ((float)(w/2)) / (float)h, 0.1f, 100.0f);
-
-
-  sphere_shader->setUniformValue("modelview_projection_uni", view * projection_matrix);
-
-	sphere_shader->setUniformValue("tex_uni", 0);
-  sphere_shader->setUniformValue("tex_info", 1);
-  sphere_shader->setUniformValue("cylinder_type", cylinder_screen_);
-  sphere_shader->setUniformValue("vertex_x_disp", eyedisp);
-	video_tex->bind(0);
-  info_tex_->bind(1);
-
-  int eye_inv = invert_stereo ? eye : 1 - eye;
-
-	switch(video_projection_mode)
-	{
-		case Monoscopic:
-			sphere_shader->setUniformValue("min_max_uv_uni", 0.0f, 0.0f, 1.0f, 1.0f);
-			break;
-		case OverUnder:
-			if(eye_inv == 1)
-        sphere_shader->setUniformValue("min_max_uv_uni", 0.0f, 0.5f, 1.0f, 1.0f);
-			else
-        sphere_shader->setUniformValue("min_max_uv_uni", 0.0f, 0.0f, 1.0f, 0.5f);
-			break;
-		case SideBySide:
-			if(eye_inv == 1)
-				sphere_shader->setUniformValue("min_max_uv_uni", 0.0f, 0.0f, 0.5f, 1.0f);
-			else
-				sphere_shader->setUniformValue("min_max_uv_uni", 0.5f, 0.0f, 1.0f, 1.0f);
-			break;
-	}
-
-	sphere_shader->setUniformValue("projection_angle_factor_uni", 360.0f / (float)video_angle);
-
-	cube_vao.bind();
-  gl->glDrawArrays(GL_TRIANGLES, 0, cube_vertices_.size());
-	cube_vao.release();
-	sphere_shader->release();
-
-
-
-/*QOpenGLFramebufferObject::bindDefault();
-
-	gl->glViewport(eye == 1 ? w/2 : 0, 0, w/2, h);
-
-	distortion_shader->bind();
-	distortion_shader->setUniformValue("tex_uni", 0);
-	distortion_shader->setUniformValue("barrel_power_uni", barrel_power);
-
-	gl->glActiveTexture(GL_TEXTURE0);
-	gl->glBindTexture(GL_TEXTURE_2D, fbo->texture());
-
-	screen_vao.bind();
-	gl->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	screen_vao.release();
-
-	distortion_shader->release();*/
 }
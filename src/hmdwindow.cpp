@@ -17,19 +17,18 @@
  */
 
 #include <cstring>
-#include <fstream>
 
 #include <QBoxLayout>
 #include <QKeyEvent>
 
 #include "psvr.h"
 #include "psvr_control.h"
-#include "tile.h"
 #include "hmdwindow.h"
 
 HMDWindow::HMDWindow(VideoPlayer *video_player, PsvrSensors *psvr,
     PsvrControl* psvr_control, QWidget *parent): QMainWindow(parent),
-    psvr_control_(psvr_control) {
+    media_duration_(0), current_play_position_(0),
+    hud_(info_scr_.GetGlyphs(), InformationScreen::GetCellCount()), psvr_control_(psvr_control) {
 	this->video_player = video_player;
 	this->psvr = psvr;
 
@@ -39,20 +38,27 @@ HMDWindow::HMDWindow(VideoPlayer *video_player, PsvrSensors *psvr,
 
 	resize(640, 480);
 
-  compose_scr_.resize(kScrWidth * kScrHeight);
-  LoadTestInfo();
-
 	hmd_widget = new HMDWidget(video_player, psvr);
-  info_data_ = hmd_widget->GetInfoData();
+  hmd_widget->SetOverlayAtlas(kSpriteAtlasTexture, info_scr_.GetAtlas());
+  hmd_widget->SetOverlayAtlas(kGlyphAtlasTexture, info_scr_.GetGlyphAtlas());
+  hmd_widget->SetTestScreenFile("info_test.data", kScrWidth, kScrHeight);
+  hmd_widget->SetFrameHud(&hud_);
   setCentralWidget(hmd_widget);
   ShowMenu();
 
+  connect(&play_time_timer_, SIGNAL(timeout()), this, SLOT(UpdatePlayTime()));
+  play_time_timer_.setInterval(kPlayTimeInterval);
+  play_time_timer_.start();
+
+  connect(&hud_timer_, SIGNAL(timeout()), this, SLOT(UpdateHud()));
+  hud_timer_.setInterval(kHudInterval);
 
   connect(video_player, SIGNAL(Playing()), this, SLOT(PlayerPlaying()));
 }
 
 HMDWindow::~HMDWindow()
 {
+  psvr_control_->ClearCallbacks();
 	delete hmd_widget;
 }
 
@@ -92,15 +98,6 @@ void HMDWindow::closeEvent(QCloseEvent *event)
   QMainWindow::closeEvent(event);
 }
 
-void HMDWindow::LoadTestInfo() {
-  std::ifstream f("info_test.data", std::ios_base::binary);
-  if (f) {
-    test_scr_.resize(kScrWidth * kScrHeight);
-    f.read(reinterpret_cast<char*>(test_scr_.data()), kScrWidth * kScrHeight * sizeof(uint32_t));
-  }
-}
-
-
 void HMDWindow::OnUp() {
   if (show_menu_) {
     info_scr_.DoUp();
@@ -178,6 +175,7 @@ void HMDWindow::PlayerMakeStep(int move_ms) {
 
   video_player->SetPosition(static_cast<float>(current_play_position_) /
       media_duration_);
+  play_time_hide_ = std::chrono::steady_clock::now() + kPlayTimeShowInterval;
 }
 
 void HMDWindow::ShowMenu()
@@ -188,23 +186,9 @@ void HMDWindow::ShowMenu()
 }
 
 void HMDWindow::UpdateInformation() {
-  if (compose_scr_.size() == test_scr_.size()) {
-    memcpy(compose_scr_.data(), test_scr_.data(), compose_scr_.size() * sizeof(uint32_t));
-  } else {
-    std::memset(compose_scr_.data(), 0, compose_scr_.size() * sizeof(uint32_t));
-  }
-
-  auto& scr = info_scr_.GetInfoScr();
-  AddTile(compose_scr_, kScrWidth, scr, info_scr_.GetInfoScrWidth(),
-      kInfoScrXPos, kInfoScrYPos);
-
-  if (kScrWidth != HMDWidget::kInfoWidth || kScrHeight != HMDWidget::kInfoHeight) {
-    assert(false);
-    return;
-  }
-
-  memcpy(info_data_, compose_scr_.data(), compose_scr_.size() * sizeof(uint32_t));
-  hmd_widget->ForceUpdateInfo();
+  std::vector<OverlayQuad> quads;
+  info_scr_.GetQuads(quads, kInfoScrXPos, kInfoScrYPos);
+  hmd_widget->SetOverlay(quads);
 }
 
 
@@ -226,16 +210,64 @@ void HMDWindow::ActionPlay() {
 }
 
 void HMDWindow::PlayerPlaying() {
-  if (!psvr_control_->IsOpened() && !psvr_control_->OpenDevice()) {
-    info_scr_.SetNoVrWarning(true);
-  }
-  else {
-    info_scr_.SetNoVrWarning(false);
-    psvr_control_->SetVRMode(true);
+  // Шлем открывается и переключается потоком управления, окно не ждёт USB.
+  // Результат приходит в OnVRModeSet
+  if (!psvr_control_->IsOpened()) {
+    psvr_control_->OpenDevice();
   }
+  psvr_control_->SetVRMode(true, [this](bool success) {
+    QMetaObject::invokeMethod(this, "OnVRModeSet", Qt::QueuedConnection, Q_ARG(bool, success));
+  });
   HideMenu();
 
   // TODO
 //  hmd_window->SwitchFullScreen(true);
 //  hmd_window->activateWindow();
 }
+
+void HMDWindow::OnVRModeSet(bool success) {
+  info_scr_.SetNoVrWarning(!success);
+  UpdateInformation();
+}
+
+void HMDWindow::UpdatePlayTime() {
+  bool show = media_duration_ > 0 &&
+      (show_menu_ || std::chrono::steady_clock::now() < play_time_hide_);
+  info_scr_.ShowPlayTime(show);
+  if (show) {
+    int64_t time = video_player->GetTime();
+    uint64_t pos = time >= 0 ? time : current_play_position_;
+    QString text = MainWindow::FormatPlayTime(pos) + " / " +
+        MainWindow::FormatPlayTime(media_duration_);
+    info_scr_.SetPlayTime(text.toStdString(), static_cast<float>(pos) / media_duration_);
+  }
+
+  std::vector<OverlayCell> cells;
+  info_scr_.TakeChangedCells(cells, kInfoScrXPos, kInfoScrYPos);
+  if (!cells.empty()) {
+    hmd_widget->UpdateOverlayCells(cells);
+  }
+}
+
+void HMDWindow::ShowHud(bool show) {
+  hud_.SetVisible(show);
+  if (show) {
+    hud_timer_.start();
+  } else {
+    hud_timer_.stop();
+  }
+  UpdateHud();
+}
+
+void HMDWindow::OnToggleHud() {
+  ShowHud(!hud_.IsVisible());
+}
+
+void HMDWindow::UpdateHud() {
+  hud_.Update();
+  std::vector<OverlayCell> cells;
+  hud_.TakeChangedCells(cells, kHudXPos, kHudYPos);
+  if (!cells.empty()) {
+    hmd_widget->UpdateOverlayCells(cells);
+  }
+}
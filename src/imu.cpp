@@ -0,0 +1,248 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "imu.h"
+
+#include "sensor_device.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const size_t kFirstSampleOffset = 16;
+const size_t kSampleSize = 16; //!< tick (4 bytes), gyro (3 x 2 bytes), accelerometer (3 x 2 bytes)
+
+inline int16_t ReadInt16(const unsigned char* buffer, size_t offset) {
+  return static_cast<int16_t>(buffer[offset] | (buffer[offset + 1] << 8));
+}
+
+inline uint32_t ReadUInt32(const unsigned char* buffer, size_t offset) {
+  return static_cast<uint32_t>(buffer[offset]) |
+      (static_cast<uint32_t>(buffer[offset + 1]) << 8) |
+      (static_cast<uint32_t>(buffer[offset + 2]) << 16) |
+      (static_cast<uint32_t>(buffer[offset + 3]) << 24);
+}
+
+const double kRadiansInDegree = 3.14159265358979323846 / 180.0;
+
+} // namespace
+
+
+size_t ParseSensorReport(const unsigned char* data, size_t size, ImuSample* samples) {
+  if (size != kSensorReportSize) {
+    return 0;
+  }
+
+  for (size_t i = 0; i < kImuSamplesPerReport; ++i) {
+    size_t offset = kFirstSampleOffset + i * kSampleSize;
+    ImuSample& s = samples[i];
+    s.tick = ReadUInt32(data, offset);
+    s.gyro_yaw = ReadInt16(data, offset + 4);
+    s.gyro_pitch = ReadInt16(data, offset + 6);
+    s.gyro_roll = ReadInt16(data, offset + 8);
+    s.accel[0] = ReadInt16(data, offset + 10);
+    s.accel[1] = ReadInt16(data, offset + 12);
+    s.accel[2] = ReadInt16(data, offset + 14);
+  }
+  return kImuSamplesPerReport;
+}
+
+
+ImuQuaternion MultiplyQuaternions(const ImuQuaternion& q1, const ImuQuaternion& q2) {
+  ImuQuaternion r;
+  r.w = q1.w * q2.w - q1.x * q2.x - q1.y * q2.y - q1.z * q2.z;
+  r.x = q1.w * q2.x + q1.x * q2.w + q1.y * q2.z - q1.z * q2.y;
+  r.y = q1.w * q2.y - q1.x * q2.z + q1.y * q2.w + q1.z * q2.x;
+  r.z = q1.w * q2.z + q1.x * q2.y - q1.y * q2.x + q1.z * q2.w;
+  return r;
+}
+
+double ClampGyroBias(double velocity) {
+  const double max_bias = kMaxGyroBiasUnits * kGyroCoef;
+  return std::max(-max_bias, std::min(velocity, max_bias));
+}
+
+void RotateVector(const ImuQuaternion& q, const double v[3], double result[3]) {
+  // v + w * t + u x t, where t = 2 * u x v and u is vector part of q
+  double t[3] = {
+      2.0 * (q.y * v[2] - q.z * v[1]),
+      2.0 * (q.z * v[0] - q.x * v[2]),
+      2.0 * (q.x * v[1] - q.y * v[0])};
+  result[0] = v[0] + q.w * t[0] + q.y * t[2] - q.z * t[1];
+  result[1] = v[1] + q.w * t[1] + q.z * t[0] - q.x * t[2];
+  result[2] = v[2] + q.w * t[2] + q.x * t[1] - q.y * t[0];
+}
+
+void GetRotationAngles(const ImuQuaternion& q, double angles[3]) {
+  // The shortest rotation: w must be positive
+  double sign = q.w < 0.0 ? -1.0 : 1.0;
+  double sin_half = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z);
+  double angle = 2.0 * std::atan2(sin_half, sign * q.w);
+  double k = sin_half > 1e-12 ? sign * angle / sin_half : 2.0;
+  angles[0] = q.x * k / kRadiansInDegree;
+  angles[1] = q.y * k / kRadiansInDegree;
+  angles[2] = q.z * k / kRadiansInDegree;
+}
+
+void GetAngularVelocity(const ImuSample& sample, const double velo[3], double result[3]) {
+  result[0] = -sample.gyro_pitch * kGyroCoef - velo[0];
+  result[1] = -sample.gyro_yaw * kGyroCoef - velo[1];
+  result[2] = -sample.gyro_roll * kGyroCoef - velo[2];
+}
+
+
+ImuIntegrator::ImuIntegrator(): has_tick_(false), last_tick_(0),
+    tilt_correction_(true), reference_pending_(true),
+    reference_gravity_{0.0, -1.0, 0.0}, bias_{0.0, 0.0, 0.0} {
+}
+
+void ImuIntegrator::Reset() {
+  has_tick_ = false;
+}
+
+void ImuIntegrator::ResetReference() {
+  reference_pending_ = true;
+}
+
+void ImuIntegrator::SetTiltCorrection(bool enabled) {
+  tilt_correction_ = enabled;
+  bias_[0] = bias_[1] = bias_[2] = 0.0;
+}
+
+double ImuIntegrator::Integrate(const ImuSample& sample, const double velo[3], ImuQuaternion& orientation) {
+  // Unsigned difference handles wrap around of the device timer
+  uint32_t interval = sample.tick - last_tick_;
+  bool valid = has_tick_ && interval > 0 && interval <= kMaxSampleIntervalUs;
+  has_tick_ = true;
+  last_tick_ = sample.tick;
+  if (!valid) {
+    return 0.0;
+  }
+
+  double ims = interval * 0.001;
+  double speed[3];
+  GetAngularVelocity(sample, velo, speed);
+  if (tilt_correction_) {
+    CorrectTilt(sample, orientation, ims, speed);
+  }
+
+  double half = 0.5 * kRadiansInDegree * ims;
+  ImuQuaternion delta;
+  delta.w = 1.0;
+  delta.x = speed[0] * half;
+  delta.y = speed[1] * half;
+  delta.z = speed[2] * half;
+
+  // Gyro measures rotation in the helmet frame, so the sample rotation is applied first
+  ImuQuaternion q = MultiplyQuaternions(orientation, delta);
+
+  // Norm stays close to 1, so first order of 1/sqrt(n) is enough to renormalize
+  double n = q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z;
+  double k = (3.0 - n) * 0.5;
+  orientation.w = q.w * k;
+  orientation.x = q.x * k;
+  orientation.y = q.y * k;
+  orientation.z = q.z * k;
+  return ims;
+}
+
+void ImuIntegrator::CorrectTilt(const ImuSample& sample, const ImuQuaternion& orientation,
+    double ims, double speed[3]) {
+  // Accelerometer axes go in the same order as gyro ones
+  double acc[3] = {-static_cast<double>(sample.accel[1]),
+      -static_cast<double>(sample.accel[0]), -static_cast<double>(sample.accel[2])};
+  double norm = std::sqrt(acc[0] * acc[0] + acc[1] * acc[1] + acc[2] * acc[2]);
+  if (std::fabs(norm / kAccelOneG - 1.0) > kAccelTolerance) {
+    // The helmet is moving with acceleration: gravity isn't known
+    return;
+  }
+  for (auto& a: acc) {
+    a /= norm;
+  }
+
+  if (reference_pending_) {
+    // The reference keeps tilt of the moment of view resetting
+    RotateVector(orientation, acc, reference_gravity_);
+    reference_pending_ = false;
+    return;
+  }
+
+  // Expected gravity direction in the helmet frame
+  ImuQuaternion inverse = {orientation.w, -orientation.x, -orientation.y, -orientation.z};
+  double expected[3];
+  RotateVector(inverse, reference_gravity_, expected);
+
+  // Mahony filter: rotation from measured to expected direction turns the
+  // orientation to the gravity. Its integral is gyro bias of tilt axes
+  double error[3] = {
+      acc[1] * expected[2] - acc[2] * expected[1],
+      acc[2] * expected[0] - acc[0] * expected[2],
+      acc[0] * expected[1] - acc[1] * expected[0]};
+  for (size_t i = 0; i < 3; ++i) {
+    bias_[i] += error[i] * kTiltKi * ims;
+    speed[i] += (error[i] * kTiltKp + bias_[i]) / kRadiansInDegree;
+  }
+}
+
+
+StillnessDetector::StillnessDetector() {
+  Clear();
+}
+
+void StillnessDetector::Clear() {
+  count_ = 0;
+  for (size_t i = 0; i < kChannels; ++i) {
+    sum_[i] = 0.0;
+    square_sum_[i] = 0.0;
+  }
+}
+
+bool StillnessDetector::AddSample(const ImuSample& sample, double bias[3]) {
+  const double values[kChannels] = {
+      static_cast<double>(sample.gyro_yaw), static_cast<double>(sample.gyro_pitch),
+      static_cast<double>(sample.gyro_roll), static_cast<double>(sample.accel[0]),
+      static_cast<double>(sample.accel[1]), static_cast<double>(sample.accel[2])};
+  for (size_t i = 0; i < kChannels; ++i) {
+    sum_[i] += values[i];
+    square_sum_[i] += values[i] * values[i];
+  }
+  if (++count_ < kWindowSamples) {
+    return false;
+  }
+
+  bool still = true;
+  double mean[kChannels];
+  for (size_t i = 0; i < kChannels; ++i) {
+    mean[i] = sum_[i] / count_;
+    double variance = square_sum_[i] / count_ - mean[i] * mean[i];
+    still = still && variance < (i < 3 ? kStillGyroVariance : kStillAccelVariance);
+    // Steady turn: the gyro is too far from zero for bias
+    still = still && (i >= 3 || std::fabs(mean[i]) <= kMaxGyroBiasUnits);
+  }
+  Clear();
+  if (!still) {
+    return false;
+  }
+
+  // Compensation speed makes angle speed of the still helmet zero
+  bias[0] = -mean[1] * kGyroCoef;
+  bias[1] = -mean[0] * kGyroCoef;
+  bias[2] = -mean[2] * kGyroCoef;
+  return true;
+}
@@ -1,15 +1,40 @@
 #include "info_screen.h"
 
-#include <QDataStream>
-#include <QFile>
+#include "sprite_atlas_data.h"
 
-InformationScreen::InformationScreen(): active_pos_(kMenuPlay), screen_changed_(true),
-    active_selection_(2), no_vr_(false), show_menu_(true), setting_invert_(0) {
-  info_scr_.resize(kScrWidth * kScrHeight); // If memory lack, exception finishs constructor
-  active_pos_ = kMenuPlay;
+using namespace sprite_atlas;
+
+namespace {
 
+constexpr bool IsSpriteSize(SpriteId id, size_t width, size_t height) {
+  return kRects[id].width == width && kRects[id].height == height;
+}
 
-  LoadResources();
+} // namespace
+
+
+InformationScreen::InformationScreen(): glyphs_(kGlyphSize),
+    play_time_(glyphs_, 0, kPlayTimeLength, 250, kTileHeight * 5 + 20),
+    progress_(glyphs_, kPlayTimeLength, kProgressSegments, 250,
+        kTileHeight * 5 + 20 + glyphs_.GetCellHeight(), kTileWidth * 5, kProgressHeight),
+    active_pos_(kMenuPlay), screen_changed_(true),
+    active_selection_(2), no_vr_(false), show_menu_(true), setting_invert_(0) {
+  // Размеры картинок атласа проверяются при компиляции
+  static_assert(IsSpriteSize(kInvert0Sprite, kTileWidth, kTileHeight) &&
+      IsSpriteSize(kInvert1Sprite, kTileWidth, kTileHeight) &&
+      IsSpriteSize(kPlaySprite, kTileWidth, kTileHeight) &&
+      IsSpriteSize(kFastBackwardSprite, kTileWidth, kTileHeight) &&
+      IsSpriteSize(kBackwardSprite, kTileWidth, kTileHeight) &&
+      IsSpriteSize(kForwardSprite, kTileWidth, kTileHeight) &&
+      IsSpriteSize(kFastForwardSprite, kTileWidth, kTileHeight) &&
+      IsSpriteSize(kSelectorSprite, kTileWidth, kTileHeight),
+      "Menu sprites must be kTileWidth x kTileHeight");
+  static_assert(IsSpriteSize(kNoVrSprite, kWarningWidth, kWarningHeight),
+      "Warning sprite must be kWarningWidth x kWarningHeight");
+
+  atlas_.width = kWidth;
+  atlas_.height = kHeight;
+  atlas_.pixels = kPixels;
 
   DrawScreen();
 }
@@ -18,13 +43,36 @@ InformationScreen::~InformationScreen() {
 
 }
 
-const std::vector<uint32_t>& InformationScreen::GetInfoScr() {
+void InformationScreen::GetQuads(std::vector<OverlayQuad>& quads, size_t xpos, size_t ypos) {
   if (screen_changed_) {
     screen_changed_ = false;
     DrawScreen();
   }
-  return info_scr_;
 
+  for (auto& place: layout_) {
+    auto& r = kRects[place.sprite];
+    OverlayQuad quad = {kSpriteAtlasTexture,
+        static_cast<float>(xpos + place.x), static_cast<float>(ypos + place.y),
+        static_cast<float>(r.width), static_cast<float>(r.height),
+        static_cast<float>(r.x), static_cast<float>(r.y),
+        static_cast<float>(r.width), static_cast<float>(r.height)};
+    quads.push_back(quad);
+  }
+}
+
+void InformationScreen::SetPlayTime(const std::string& text, float progress) {
+  play_time_.SetText(text);
+  progress_.SetProgress(progress);
+}
+
+void InformationScreen::ShowPlayTime(bool show) {
+  play_time_.SetVisible(show);
+  progress_.SetVisible(show);
+}
+
+void InformationScreen::TakeChangedCells(std::vector<OverlayCell>& cells, size_t xpos, size_t ypos) {
+  play_time_.TakeChangedCells(cells, xpos, ypos);
+  progress_.TakeChangedCells(cells, xpos, ypos);
 }
 
 void InformationScreen::DoRight() {
@@ -126,49 +174,13 @@ void InformationScreen::ShowMenu(bool show_menu) {
 }
 
 
-void InformationScreen::LoadResources() {
-  LoadResFile(invert_0_tile_, "invert_0.data", kTileSize);
-  LoadResFile(invert_1_tile_, "invert_1.data", kTileSize);
-  LoadResFile(play_tile_, "play.data", kTileSize);
-
-  LoadResFile(fast_backward_tile_, "fastbackward.data", kTileSize);
-  LoadResFile(backward_tile_, "backward.data", kTileSize);
-  LoadResFile(forward_tile_, "forward.data", kTileSize);
-  LoadResFile(fast_forward_tile_, "fastforward.data", kTileSize);
-
-  LoadResFile(selector_tile_, "selector.data", kTileSize);
-  LoadResFile(no_vr_tile_, "no_vr.data", kWarningSize);
-}
-
-void InformationScreen::LoadResFile(std::vector<uint32_t>& storage, std::string fname, size_t req_size) {
-  storage.clear();
-  int rawsize = req_size * sizeof(uint32_t);
-  assert(rawsize / sizeof(uint32_t) == req_size);
-  try {
-    std::string ffn = ":/sprite/" + fname;
-    QFile f(ffn.c_str());
-    if (!f.open(QIODevice::ReadOnly | QIODevice::ExistingOnly)) {
-      throw std::runtime_error(std::string("Can't find resource ") + fname);
-    }
-    QDataStream ds(&f);
-    storage.resize(req_size);
-    auto rd = ds.readRawData((char*)storage.data(), rawsize);
-    if (rd < rawsize) {
-      storage.clear();
-      throw std::runtime_error(std::string("Not enough data into resource ") + fname);
-    }
-  }
-  catch (std::bad_alloc&) {
-    throw std::runtime_error(std::string("Can't load resource ") + fname);
-  }
-}
-
-void InformationScreen::Tile(const Image& img, size_t x, size_t y, size_t width) {
-  AddTile(info_scr_, kScrWidth, img, width, x, y);
+void InformationScreen::Tile(SpriteId sprite, size_t x, size_t y) {
+  Placement place = {sprite, x, y};
+  layout_.push_back(place);
 }
 
 void InformationScreen::DrawScreen() {
-  memset(info_scr_.data(), 0, info_scr_.size() * sizeof(uint32_t));
+  layout_.clear();
 
   if (show_menu_) {
     DrawInvertMenu(active_pos_, active_selection_);
@@ -176,35 +188,35 @@ void InformationScreen::DrawScreen() {
   }
 
   if (no_vr_) {
-    Tile(no_vr_tile_, kScrWidth - kWarningWidth, 0, kWarningWidth);
+    Tile(kNoVrSprite, kScrWidth - kWarningWidth, 0);
   }
 }
 
 void InformationScreen::DrawInvertMenu(InformationScreen::MenuPosition pos, int sel) {
   size_t ry = kTileHeight * 3;
   if (setting_invert_ == 0) {
-    Tile(invert_0_tile_, 0, ry);
+    Tile(kInvert0Sprite, 0, ry);
   } else {
-    Tile(invert_1_tile_, 0, ry);
+    Tile(kInvert1Sprite, 0, ry);
   }
 
   if (pos == kMenuInvert && sel >= 0 && sel < 2) {
-    Tile(invert_0_tile_, kTileWidth, ry);
-    Tile(invert_1_tile_, kTileWidth * 2, ry);
-    Tile(selector_tile_, kTileWidth * (sel + 1), ry);
+    Tile(kInvert0Sprite, kTileWidth, ry);
+    Tile(kInvert1Sprite, kTileWidth * 2, ry);
+    Tile(kSelectorSprite, kTileWidth * (sel + 1), ry);
   }
 }
 
 void InformationScreen::DrawPlayMenu(InformationScreen::MenuPosition pos, int sel) {
   size_t ry = kTileHeight * 4;
   size_t rx = 250;
-  Tile(fast_backward_tile_, rx, ry);
-  Tile(backward_tile_, rx + kTileWidth, ry);
-  Tile(play_tile_, rx + kTileWidth * 2, ry);
-  Tile(forward_tile_, rx + kTileWidth * 3, ry);
-  Tile(fast_forward_tile_, rx + kTileWidth * 4, ry);
+  Tile(kFastBackwardSprite, rx, ry);
+  Tile(kBackwardSprite, rx + kTileWidth, ry);
+  Tile(kPlaySprite, rx + kTileWidth * 2, ry);
+  Tile(kForwardSprite, rx + kTileWidth * 3, ry);
+  Tile(kFastForwardSprite, rx + kTileWidth * 4, ry);
   if (pos == kMenuPlay && sel >= 0 && sel < 5) {
-    Tile(selector_tile_, rx + sel * kTileWidth, ry);
+    Tile(kSelectorSprite, rx + sel * kTileWidth, ry);
   }
 }
 
@@ -44,7 +44,9 @@ KeyEvent g_keys[] = {
   {Qt::Key_Up,    true,  false, false, [](KeyFilter* kf){ emit kf->ResetView(); }},
   {Qt::Key_Down,  true,  false, false, [](KeyFilter* kf){ emit kf->CompensateView(); }},
   // Full screen
-  {Qt::Key_F11,   false, false, false, [](KeyFilter* kf){ emit kf->FullScreen(); }}
+  {Qt::Key_F11,   false, false, false, [](KeyFilter* kf){ emit kf->FullScreen(); }},
+  // Frame timing in the helmet
+  {Qt::Key_H,     false, false, false, [](KeyFilter* kf){ emit kf->ToggleHud(); }}
 };
 
 bool KeyFilter::eventFilter(QObject*, QEvent* event) {
@@ -0,0 +1,144 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+LatencyHistogram::LatencyHistogram(): count_(0), max_(0) {
+  for (auto& b: buckets_) {
+    b.store(0, std::memory_order_relaxed);
+  }
+}
+
+size_t LatencyHistogram::GetBucket(uint64_t value) {
+  if (value < kSubBuckets) {
+    return static_cast<size_t>(value);
+  }
+  // Position of the highest bit defines the power of two, next bits are the sub-bucket
+  size_t high = 63 - __builtin_clzll(value);
+  size_t shift = high - kSubBits;
+  size_t sub = static_cast<size_t>(value >> shift) & (kSubBuckets - 1);
+  return (shift + 1) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::GetBucketTop(size_t bucket) {
+  if (bucket < kSubBuckets) {
+    return bucket;
+  }
+  size_t shift = bucket / kSubBuckets - 1;
+  uint64_t sub = bucket % kSubBuckets;
+  return (((kSubBuckets + sub + 1) << shift) - 1);
+}
+
+void LatencyHistogram::Record(uint64_t value_us) {
+  buckets_[GetBucket(value_us)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  uint64_t prev = max_.load(std::memory_order_relaxed);
+  while (value_us > prev && !max_.compare_exchange_weak(prev, value_us, std::memory_order_relaxed)) {
+  }
+}
+
+uint64_t LatencyHistogram::GetCount() const {
+  return count_.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::GetMax() const {
+  return max_.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::GetPercentile(double percentile) const {
+  uint64_t count = GetCount();
+  if (count == 0) {
+    return 0;
+  }
+  // Number of values not greater than the percentile
+  uint64_t target = static_cast<uint64_t>(std::ceil(count * percentile / 100.0));
+  if (target == 0) {
+    target = 1;
+  }
+  uint64_t sum = 0;
+  for (size_t i = 0; i < kBucketCount; ++i) {
+    sum += buckets_[i].load(std::memory_order_relaxed);
+    if (sum >= target) {
+      uint64_t top = GetBucketTop(i);
+      uint64_t max = GetMax();
+      return top < max ? top : max;
+    }
+  }
+  return GetMax();
+}
+
+std::string LatencyHistogram::Format() const {
+  char buffer[128];
+  snprintf(buffer, sizeof(buffer), "n %llu, p50 %llu us, p99 %llu us, max %llu us",
+      static_cast<unsigned long long>(GetCount()),
+      static_cast<unsigned long long>(GetPercentile(50.0)),
+      static_cast<unsigned long long>(GetPercentile(99.0)),
+      static_cast<unsigned long long>(GetMax()));
+  return buffer;
+}
+
+
+RollingPercentiles::RollingPercentiles(size_t window): window_(window), next_(0) {
+  values_.reserve(window_);
+}
+
+void RollingPercentiles::Record(uint64_t value_us) {
+  if (values_.size() < window_) {
+    values_.push_back(value_us);
+    return;
+  }
+  values_[next_] = value_us;
+  next_ = (next_ + 1) % window_;
+}
+
+uint64_t RollingPercentiles::GetLast() const {
+  if (values_.empty()) {
+    return 0;
+  }
+  if (values_.size() < window_) {
+    return values_.back();
+  }
+  return values_[(next_ + window_ - 1) % window_];
+}
+
+uint64_t RollingPercentiles::GetPercentile(double percentile) const {
+  if (values_.empty()) {
+    return 0;
+  }
+  std::vector<uint64_t> sorted(values_);
+  size_t index = static_cast<size_t>(std::ceil(sorted.size() * percentile / 100.0));
+  index = index > 0 ? index - 1 : 0;
+  if (index >= sorted.size()) {
+    index = sorted.size() - 1;
+  }
+  std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+  return sorted[index];
+}
+
+std::string RollingPercentiles::Format() const {
+  char buffer[96];
+  snprintf(buffer, sizeof(buffer), "p50 %llu us, p95 %llu us, max %llu us",
+      static_cast<unsigned long long>(GetPercentile(50.0)),
+      static_cast<unsigned long long>(GetPercentile(95.0)),
+      static_cast<unsigned long long>(GetPercentile(100.0)));
+  return buffer;
+}
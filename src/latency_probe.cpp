@@ -0,0 +1,192 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "latency_probe.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+
+#include "imu.h"
+
+namespace {
+
+const uint32_t kReportIntervalUs = 1000; //!< Reports of the helmet come every 1 ms
+const uint32_t kStepPeriodUs = 500000; //!< Steps are separated so every step is rendered before the next one
+const uint32_t kStepDurationUs = 100000;
+const int16_t kStepGyro = 2000; //!< Yaw speed of the step, gyro units (about 125 degrees per second)
+const char* const kStageNames[kLatencyStageCount] = {
+    "Publish", "Pose read", "Render", "Swap"};
+
+void WriteInt16(unsigned char* buffer, size_t offset, int16_t value) {
+  buffer[offset] = static_cast<unsigned char>(value & 0xff);
+  buffer[offset + 1] = static_cast<unsigned char>((value >> 8) & 0xff);
+}
+
+void WriteUInt32(unsigned char* buffer, size_t offset, uint32_t value) {
+  for (size_t i = 0; i < 4; ++i) {
+    buffer[offset + i] = static_cast<unsigned char>((value >> (8 * i)) & 0xff);
+  }
+}
+
+/*! Generates reports of the helmet in real time. The yaw speed steps up for
+kStepDurationUs every kStepPeriodUs, the direction alternates, so the view
+swings around the start */
+class StepSensorDevice: public SensorDevice {
+ public:
+  explicit StepSensorDevice(std::shared_ptr<LatencyProbe> probe):
+      probe_(probe), tick_(kStepPeriodUs / 2), interrupted_(false) {
+    // The first step comes after start of integration
+    next_ = std::chrono::steady_clock::now();
+  }
+
+  bool WaitReports(std::vector<SensorReport>& reports, int timeout_ms) override {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+    {
+      std::unique_lock<std::mutex> lk(lock_);
+      cv_.wait_until(lk, next_ < deadline ? next_ : deadline, [this](){ return interrupted_; });
+      if (interrupted_) {
+        interrupted_ = false;
+        return true;
+      }
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    while (next_ <= now) {
+      AddReport(reports, now);
+      next_ += std::chrono::microseconds(kReportIntervalUs);
+    }
+    return true;
+  }
+
+  void Interrupt() override {
+    std::lock_guard<std::mutex> lk(lock_);
+    interrupted_ = true;
+    cv_.notify_all();
+  }
+
+  const char* GetName() const override { return "step simulation"; }
+
+ private:
+  std::shared_ptr<LatencyProbe> probe_;
+  std::chrono::steady_clock::time_point next_;
+  uint32_t tick_;
+
+  std::mutex lock_;
+  std::condition_variable cv_;
+  bool interrupted_;
+
+  void AddReport(std::vector<SensorReport>& reports, std::chrono::steady_clock::time_point now) {
+    SensorReport report;
+    memset(report.data, 0, sizeof(report.data));
+    report.size = kSensorReportSize;
+    report.time = now;
+
+    const uint32_t sample_interval = kReportIntervalUs / kImuSamplesPerReport;
+    for (size_t i = 0; i < kImuSamplesPerReport; ++i) {
+      uint32_t phase = tick_ % kStepPeriodUs;
+      bool forward = (tick_ / kStepPeriodUs) % 2 == 0;
+      int16_t yaw = phase < kStepDurationUs ? (forward ? kStepGyro : -kStepGyro) : 0;
+      if (phase < sample_interval) {
+        probe_->Inject(tick_, now);
+      }
+
+      // Layout of the sample is described in ParseSensorReport. Level helmet
+      // has gravity along accelerometer axis 0
+      size_t offset = 16 + i * 16;
+      WriteUInt32(report.data, offset, tick_);
+      WriteInt16(report.data, offset + 4, yaw);
+      WriteInt16(report.data, offset + 10, static_cast<int16_t>(kAccelOneG));
+      tick_ += sample_interval;
+    }
+    reports.push_back(report);
+  }
+};
+
+} // namespace
+
+
+LatencyProbe::LatencyProbe(): injected_(false), tagged_(false), tick_(0),
+    sequence_(0), reached_(0), dropped_(0) {
+}
+
+void LatencyProbe::Inject(uint32_t tick, std::chrono::steady_clock::time_point time) {
+  std::lock_guard<std::mutex> lk(lock_);
+  if (injected_) {
+    ++dropped_;
+  }
+  injected_ = true;
+  tagged_ = false;
+  tick_ = tick;
+  time_ = time;
+  reached_ = kLatencyPublish;
+}
+
+void LatencyProbe::Publish(uint32_t tick, uint64_t sequence) {
+  std::lock_guard<std::mutex> lk(lock_);
+  // Signed difference handles wrap around of the device timer
+  if (!injected_ || tagged_ || static_cast<int32_t>(tick - tick_) < 0) {
+    return;
+  }
+  tagged_ = true;
+  sequence_ = sequence;
+  Record(kLatencyPublish);
+}
+
+void LatencyProbe::Reach(LatencyStage stage, uint64_t sequence) {
+  std::lock_guard<std::mutex> lk(lock_);
+  // Stages are passed in order: the frame swapped before the tagged pose was
+  // read doesn't show the step
+  if (!tagged_ || sequence < sequence_ || stage != reached_) {
+    return;
+  }
+  Record(stage);
+}
+
+void LatencyProbe::Record(LatencyStage stage) {
+  stages_[stage].Record(std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - time_).count());
+  reached_ = stage + 1;
+  if (reached_ == kLatencyStageCount) {
+    injected_ = false;
+    tagged_ = false;
+  }
+}
+
+uint64_t LatencyProbe::GetCount() const {
+  return stages_[kLatencySwap].GetCount();
+}
+
+std::string LatencyProbe::Format() const {
+  std::lock_guard<std::mutex> lk(lock_);
+  std::string res;
+  for (int i = 0; i < kLatencyStageCount; ++i) {
+    res += std::string(kStageNames[i]) + ": " + stages_[i].Format() + "\n";
+  }
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "Dropped steps: %llu\n",
+      static_cast<unsigned long long>(dropped_));
+  return res + buffer;
+}
+
+std::unique_ptr<SensorDevice> OpenStepSensorDevice(std::shared_ptr<LatencyProbe> probe) {
+  if (!probe) {
+    return std::unique_ptr<SensorDevice>();
+  }
+  return std::unique_ptr<SensorDevice>(new StepSensorDevice(probe));
+}
@@ -17,12 +17,16 @@
  */
 
 #include <QApplication>
+#include <QTimer>
 #include <QWindow>
 
 #include "videoplayer.h"
 #include "psvr.h"
 #include "mainwindow.h"
+#include "frame_log.h"
 #include "hmdwindow.h"
+#include "latency_probe.h"
+#include "session_record.h"
 
 #include "project_version.h"
 
@@ -32,6 +36,56 @@ int main(int argc, char *argv[])
 
 	printf("PSVR Player Version %s\n", PROJECT_VERSION);
 
+  // Session of the helmet can be recorded and replayed without hardware:
+  // --record <file>, --replay <file>, --replay-fast <file>
+  std::string record_file;
+  std::string replay_file;
+  bool replay_fast = false;
+  // Motion-to-photon latency is measured with simulated helmet for the given
+  // time, then the player exits: --latency-test <seconds>. It works without
+  // the helmet, e.g. with QT_QPA_PLATFORM=offscreen
+  int latency_test_sec = 0;
+  // Lens distortion is corrected by the debug table of shader/sphere.vert:
+  // --debug-distortion
+  bool debug_distortion = false;
+  // Frame timing is shown in the helmet from the start (it's toggled by H
+  // key as well) and every frame is written into CSV file:
+  // --hud, --frame-log <file>
+  bool show_hud = false;
+  std::string frame_log_file;
+  // Eye buffer resolution is scaled per axis within the bounds to fit GPU
+  // frame time into the refresh period: --eye-scale <min>:<max>, e.g. 0.5:1.
+  // Equal bounds give the constant scale, by default it's 1 (no scaling)
+  float min_eye_scale = 1.0f;
+  float max_eye_scale = 1.0f;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--record" && has_value) {
+      record_file = argv[++i];
+    } else if ((arg == "--replay" || arg == "--replay-fast") && has_value) {
+      replay_file = argv[++i];
+      replay_fast = arg == "--replay-fast";
+    } else if (arg == "--latency-test" && has_value) {
+      latency_test_sec = atoi(argv[++i]);
+    } else if (arg == "--debug-distortion") {
+      debug_distortion = true;
+    } else if (arg == "--hud") {
+      show_hud = true;
+    } else if (arg == "--frame-log" && has_value) {
+      frame_log_file = argv[++i];
+    } else if (arg == "--eye-scale" && has_value) {
+      float min_scale, max_scale;
+      if (sscanf(argv[++i], "%f:%f", &min_scale, &max_scale) == 2 && min_scale > 0.0f &&
+          min_scale <= max_scale) {
+        min_eye_scale = min_scale;
+        max_eye_scale = max_scale;
+      } else {
+        fprintf(stderr, "Wrong eye buffer scale %s, <min>:<max> is expected\n", argv[i]);
+      }
+    }
+  }
+
 	QSurfaceFormat format;
 	format.setMajorVersion(3);
 	format.setMinorVersion(3);
@@ -45,6 +99,22 @@ int main(int argc, char *argv[])
     PsvrSensors psvr;
     PsvrControl psvr_control;
 
+    std::shared_ptr<SessionRecorder> recorder;
+    if (!record_file.empty()) {
+      recorder = std::make_shared<SessionRecorder>();
+      if (!recorder->Open(record_file)) {
+        fprintf(stderr, "Failed to create session file %s\n", record_file.c_str());
+        recorder.reset();
+      }
+    }
+    std::shared_ptr<LatencyProbe> latency_probe;
+    if (latency_test_sec > 0) {
+      latency_probe = std::make_shared<LatencyProbe>();
+    }
+    psvr.SetSession(recorder, replay_file, replay_fast);
+    psvr.SetLatencyProbe(latency_probe);
+    psvr_control.SetSession(recorder, psvr.IsVirtual());
+
     VideoPlayer video_player;
 
     MainWindow main_window(&video_player, &psvr, &psvr_control);
@@ -58,6 +128,28 @@ int main(int argc, char *argv[])
 
     main_window.SetHMDWindow(&hmd_window);
     hmd_window.SetMainWindow(&main_window);
+    hmd_window.GetHMDWidget()->SetDebugDistortion(debug_distortion);
+    hmd_window.GetHMDWidget()->SetEyeScaleBounds(min_eye_scale, max_eye_scale);
+    hmd_window.ShowHud(show_hud);
+
+    if (!frame_log_file.empty()) {
+      auto frame_log = std::make_shared<FrameLog>();
+      if (frame_log->Open(frame_log_file)) {
+        hmd_window.GetHMDWidget()->SetFrameLog(frame_log);
+      } else {
+        fprintf(stderr, "Failed to create frame log %s\n", frame_log_file.c_str());
+      }
+    }
+
+    if (latency_probe) {
+      hmd_window.GetHMDWidget()->SetLatencyProbe(latency_probe);
+      QTimer::singleShot(latency_test_sec * 1000, [&app, latency_probe](){
+        printf("Motion-to-photon latency from arrival of the sensor report:\n%s",
+            latency_probe->Format().c_str());
+        // No measured step means broken pipeline
+        app.exit(latency_probe->GetCount() > 0 ? 0 : 1);
+      });
+    }
 
     //video_player.LoadVideo("test.webm");
 
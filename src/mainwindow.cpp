@@ -95,16 +95,25 @@ MainWindow::MainWindow(VideoPlayer *video_player, PsvrSensors *psvr,
   update_timer_.setInterval(std::chrono::milliseconds(kUpdateSensorsInterval));
   update_timer_.start();
 
+  connect(&device_manager_, SIGNAL(HelmetChanged()), this, SLOT(OnHelmetChanged()));
+  connect(psvr, SIGNAL(DeviceOpened(bool)), this, SLOT(OnSensorsOpened(bool)));
+  connect(psvr, SIGNAL(DeviceFailed()), this, SLOT(OnSensorsFailed()));
+  device_manager_.Start(psvr->IsVirtual());
+
   ui->FOVDoubleSpinBox->setValue(fov_);
 
   ShowHelmetState();
 
-  // Скорости поворота шлема (компенсация)
+  // Скорости поворота шлема (компенсация). Компенсация конкретного шлема
+  // загружается после его открытия
   double xv, yv, zv;
   xv = settings_.value("x_velocity", 0.0).toDouble();
   yv = settings_.value("y_velocity", 0.0).toDouble();
   zv = settings_.value("z_velocity", 0.0).toDouble();
   psvr->SetVelocity(xv, yv, zv);
+
+  // Realtime priority of sensors reading (SCHED_FIFO, 1-99). 0 - default scheduling
+  psvr->SetReaderPriority(settings_.value("sensor_rt_priority", 0).toInt());
 }
 
 MainWindow::~MainWindow()
@@ -118,11 +127,7 @@ MainWindow::~MainWindow()
 		hid_free_enumeration(hid_device_infos);
 
   if (psvr) {
-    double xv, yv, zv;
-    psvr->GetVelocity(xv, yv, zv);
-    settings_.setValue("x_velocity", xv);
-    settings_.setValue("y_velocity", yv);
-    settings_.setValue("z_velocity", zv);
+    SaveHelmetVelocity();
   }
 }
 
@@ -144,6 +149,7 @@ void MainWindow::SetHMDWindow(HMDWindow* hmdwnd)
   connect(&key_filter_, SIGNAL(Left()), hmd_window, SLOT(OnLeft()), Qt::QueuedConnection);
   connect(&key_filter_, SIGNAL(Right()), hmd_window, SLOT(OnRight()), Qt::QueuedConnection);
   connect(&key_filter_, SIGNAL(Select()), hmd_window, SLOT(OnSelect()), Qt::QueuedConnection);
+  connect(&key_filter_, SIGNAL(ToggleHud()), hmd_window, SLOT(OnToggleHud()), Qt::QueuedConnection);
 
   hmd_window->installEventFilter(&key_filter_);
 
@@ -172,15 +178,15 @@ void MainWindow::SetHMDWindow(HMDWindow* hmdwnd)
 
 	switch(hmd_widget->GetVideoProjectionMode())
 	{
-		case HMDWidget::Monoscopic:
+		case HmdRenderer::Monoscopic:
 			ui->StereoMonoscopicRadioButton->setChecked(true);
 			ui->StereoInvertCheckBox->setEnabled(false);
 			break;
-		case HMDWidget::OverUnder:
+		case HmdRenderer::OverUnder:
 			ui->StereoOverUnderRadioButton->setChecked(true);
 			ui->StereoInvertCheckBox->setEnabled(true);
 			break;
-		case HMDWidget::SideBySide:
+		case HmdRenderer::SideBySide:
 			ui->StereoSBSRadioButton->setChecked(true);
 			ui->StereoInvertCheckBox->setEnabled(true);
 			break;
@@ -384,18 +390,18 @@ void MainWindow::UpdateVideoProjection()
 
 	if(ui->StereoMonoscopicRadioButton->isChecked())
 	{
-		hmd_widget->SetVideoProjectionMode(HMDWidget::Monoscopic);
+		hmd_widget->SetVideoProjectionMode(HmdRenderer::Monoscopic);
 		ui->StereoInvertCheckBox->setEnabled(false);
 	}
 	else if(ui->StereoOverUnderRadioButton->isChecked())
 	{
-		hmd_widget->SetVideoProjectionMode(HMDWidget::OverUnder);
+		hmd_widget->SetVideoProjectionMode(HmdRenderer::OverUnder);
 		hmd_widget->SetInvertStereo(ui->StereoInvertCheckBox->isChecked());
 		ui->StereoInvertCheckBox->setEnabled(true);
 	}
 	else if(ui->StereoSBSRadioButton->isChecked())
 	{
-		hmd_widget->SetVideoProjectionMode(HMDWidget::SideBySide);
+		hmd_widget->SetVideoProjectionMode(HmdRenderer::SideBySide);
 		hmd_widget->SetInvertStereo(ui->StereoInvertCheckBox->isChecked());
 		ui->StereoInvertCheckBox->setEnabled(true);
 	}
@@ -407,19 +413,59 @@ void MainWindow::SetRGBWorkaround(bool enabled)
 }
 
 void MainWindow::UpdateTimer() {
-  if (!psvr->IsOpen()) {
-    psvr->OpenDevice();
+  // Только состояние и статистика. Шлем открывается по сигналам
+  // device_manager_ и psvr
+  ShowHelmetState();
+  if (hmd_window) {
+    ui->RenderStatsLbl->setText(QString::fromStdString(
+        hmd_window->GetHMDWidget()->GetRenderStatistics()).trimmed());
   }
-  if (!psvr_control_->IsOpened()) {
-    psvr_control_->OpenDevice();
+}
+
+void MainWindow::OnHelmetChanged() {
+  // Интерфейсы открываются и закрываются в потоках psvr и psvr_control_
+  auto ifaces = device_manager_.GetInterfaces();
+  if (!ifaces.present) {
+    psvr->RequestClose();
+    psvr_control_->CloseDevice();
+  } else {
+    if (!psvr->IsOpen() || ifaces.sensor_path != opened_interfaces_.sensor_path) {
+      psvr->RequestOpen(ifaces.sensor_path, ifaces.serial);
+    }
+    if (!psvr_control_->IsOpened() || ifaces.control_path != opened_interfaces_.control_path) {
+      psvr_control_->OpenDevice(ifaces.control_path);
+    }
   }
+  opened_interfaces_ = ifaces;
+  ShowHelmetState();
+}
+
+void MainWindow::OnSensorsOpened(bool opened) {
+  if (opened) {
+    LoadHelmetVelocity();
+  }
+  ShowHelmetState();
+}
+
+void MainWindow::OnSensorsFailed() {
+  // Чтение прерывается и при выключении шлема, поэтому повтор с задержкой
+  QTimer::singleShot(kReopenSensorsDelay, this, SLOT(ReopenSensors()));
   ShowHelmetState();
 }
 
+void MainWindow::ReopenSensors() {
+  auto ifaces = device_manager_.GetInterfaces();
+  if (ifaces.present && !psvr->IsOpen()) {
+    psvr->RequestOpen(ifaces.sensor_path, ifaces.serial);
+  }
+}
+
 
 void MainWindow::closeEvent(QCloseEvent *event)
 {
+  device_manager_.Stop();
   psvr->CloseDevice();
+  SaveHelmetVelocity();
 
 	if(hmd_window)
 	{
@@ -445,6 +491,43 @@ QString MainWindow::FormatPlayTime(uint64_t value_ms) {
       arg(sec, 2, 10, fc).arg(ms100, 1, 10, fc);
 }
 
+void MainWindow::LoadHelmetVelocity() {
+  auto serial = QString::fromStdString(psvr->GetSerial());
+  if (serial.isEmpty() || serial == helmet_serial_) {
+    // Неизвестный или тот же шлем: текущая компенсация остаётся
+    return;
+  }
+
+  // Компенсация уточняется при каждой неподвижности шлема, поэтому хранится
+  // отдельно для каждого шлема. Для нового шлема берётся общая компенсация
+  SaveHelmetVelocity();
+  double xv = settings_.value("x_velocity", 0.0).toDouble();
+  double yv = settings_.value("y_velocity", 0.0).toDouble();
+  double zv = settings_.value("z_velocity", 0.0).toDouble();
+  helmet_serial_ = serial;
+  settings_.beginGroup("helmet_" + helmet_serial_);
+  xv = settings_.value("x_velocity", xv).toDouble();
+  yv = settings_.value("y_velocity", yv).toDouble();
+  zv = settings_.value("z_velocity", zv).toDouble();
+  settings_.endGroup();
+  psvr->SetVelocity(xv, yv, zv);
+}
+
+void MainWindow::SaveHelmetVelocity() {
+  double xv, yv, zv;
+  psvr->GetVelocity(xv, yv, zv);
+  if (!helmet_serial_.isEmpty()) {
+    settings_.beginGroup("helmet_" + helmet_serial_);
+  }
+  settings_.setValue("x_velocity", xv);
+  settings_.setValue("y_velocity", yv);
+  settings_.setValue("z_velocity", zv);
+  if (!helmet_serial_.isEmpty()) {
+    settings_.endGroup();
+  }
+  settings_.sync();
+}
+
 void MainWindow::ShowHelmetState()
 {
   QString sst = "Sensors - Failed";
@@ -458,6 +541,7 @@ void MainWindow::ShowHelmetState()
 
   ui->SensorsStateLbl->setText(sst);
   ui->ControlStateLbl->setText(cst);
+  ui->SensorStatsLbl->setText(QString::fromStdString(psvr->FormatStatistics()).trimmed());
 }
 
 void MainWindow::UpdateFov() {
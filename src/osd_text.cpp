@@ -0,0 +1,261 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "osd_text.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include <QFontDatabase>
+#include <QFontMetrics>
+#include <QImage>
+#include <QPainter>
+#include <QPainterPath>
+
+namespace {
+
+const int kOutlineWidth = 2; //!< Ширина тёмной обводки символов, чтобы текст читался на светлом видео
+
+OverlayQuad MakeCellQuad(const TileRect& glyph, float x, float y, float width, float height) {
+  OverlayQuad quad = {kGlyphAtlasTexture, x, y, width, height,
+      static_cast<float>(glyph.x), static_cast<float>(glyph.y),
+      static_cast<float>(glyph.width), static_cast<float>(glyph.height)};
+  return quad;
+}
+
+} // namespace
+
+
+GlyphAtlas::GlyphAtlas(int pixel_size) {
+  QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+  font.setPixelSize(pixel_size);
+  font.setStyleStrategy(QFont::PreferAntialias);
+  QFontMetrics metrics(font);
+  cell_width_ = metrics.maxWidth() + kOutlineWidth * 2;
+  cell_height_ = metrics.height() + kOutlineWidth * 2;
+
+  size_t count = kLastGlyph - kFirstGlyph + 1;
+  size_t rows = (count + kColumns - 1) / kColumns;
+  width_ = kPadding + kColumns * (cell_width_ + kPadding);
+  height_ = kPadding + rows * (cell_height_ + kPadding);
+
+  QImage image(width_, height_, QImage::Format_RGBA8888_Premultiplied);
+  image.fill(Qt::transparent);
+  QPainter painter(&image);
+  painter.setRenderHint(QPainter::Antialiasing);
+  QPen outline(QColor(0, 0, 0, 200), kOutlineWidth * 2);
+  outline.setJoinStyle(Qt::RoundJoin);
+
+  rects_.resize(count);
+  for (size_t i = 0; i < count; ++i) {
+    char ch = static_cast<char>(kFirstGlyph + i);
+    size_t x = kPadding + (i % kColumns) * (cell_width_ + kPadding);
+    size_t y = kPadding + (i / kColumns) * (cell_height_ + kPadding);
+    rects_[i] = TileRect{x, y, cell_width_, cell_height_};
+
+    QRect cell(x, y, cell_width_, cell_height_);
+    if (ch == kFillGlyph) {
+      painter.fillRect(cell, Qt::white);
+    } else if (ch == kShadeGlyph) {
+      painter.fillRect(cell, QColor(0, 0, 0, 128));
+    } else if (ch > ' ' && ch < kLastGlyph) {
+      QPainterPath path;
+      path.addText(x + kOutlineWidth, y + kOutlineWidth + metrics.ascent(), font,
+          QString(QLatin1Char(ch)));
+      painter.strokePath(path, outline);
+      painter.fillPath(path, Qt::white);
+    }
+  }
+  painter.end();
+
+  // Формат RGBA8888 хранит байты в порядке rgba, как и остальные картинки наложения
+  pixels_.resize(width_ * height_);
+  for (size_t i = 0; i < height_; ++i) {
+    std::memcpy(pixels_.data() + i * width_, image.constScanLine(i), width_ * sizeof(uint32_t));
+  }
+}
+
+OverlayAtlas GlyphAtlas::GetAtlas() const {
+  OverlayAtlas atlas = {width_, height_, pixels_.data()};
+  return atlas;
+}
+
+const TileRect& GlyphAtlas::GetGlyphRect(char ch) const {
+  if (ch < kFirstGlyph || ch > kLastGlyph) {
+    ch = ' ';
+  }
+  return rects_[ch - kFirstGlyph];
+}
+
+
+OsdText::OsdText(const GlyphAtlas& glyphs, size_t first_cell, size_t length,
+    size_t x, size_t y): glyphs_(glyphs), first_cell_(first_cell), x_(x), y_(y),
+    text_(length, ' '), changed_(length, true), visible_(false) {
+  assert(first_cell + length <= kOverlayCellCount);
+}
+
+void OsdText::SetText(const std::string& text) {
+  for (size_t i = 0; i < text_.size(); ++i) {
+    char ch = i < text.size() ? text[i] : ' ';
+    if (text_[i] != ch) {
+      text_[i] = ch;
+      changed_[i] = true;
+    }
+  }
+}
+
+void OsdText::SetVisible(bool visible) {
+  if (visible_ != visible) {
+    visible_ = visible;
+    changed_.assign(changed_.size(), true);
+  }
+}
+
+void OsdText::TakeChangedCells(std::vector<OverlayCell>& cells, size_t xpos, size_t ypos) {
+  float width = glyphs_.GetCellWidth();
+  float height = glyphs_.GetCellHeight();
+  for (size_t i = 0; i < text_.size(); ++i) {
+    if (!changed_[i]) {
+      continue;
+    }
+    changed_[i] = false;
+
+    // Пробелы и скрытый текст не рисуются
+    bool shown = visible_ && text_[i] != ' ';
+    OverlayCell cell = {first_cell_ + i, MakeCellQuad(glyphs_.GetGlyphRect(text_[i]),
+        xpos + x_ + i * width, ypos + y_, shown ? width : 0.0f, height)};
+    cells.push_back(cell);
+  }
+}
+
+
+OsdProgressBar::OsdProgressBar(const GlyphAtlas& glyphs, size_t first_cell, size_t segments,
+    size_t x, size_t y, size_t width, size_t height): glyphs_(glyphs),
+    first_cell_(first_cell), x_(x), y_(y), width_(width), height_(height),
+    fill_(segments, 0), changed_(segments * 2, true), visible_(false) {
+  assert(segments > 0 && first_cell + segments * 2 <= kOverlayCellCount);
+}
+
+void OsdProgressBar::SetProgress(float progress) {
+  progress = std::max(0.0f, std::min(progress, 1.0f));
+  size_t filled = static_cast<size_t>(progress * width_ + 0.5f);
+  for (size_t i = 0; i < fill_.size(); ++i) {
+    size_t seg_x = GetSegmentX(i);
+    size_t fill = filled > seg_x ? std::min(filled - seg_x, GetSegmentWidth(i)) : 0;
+    if (fill_[i] != fill) {
+      fill_[i] = fill;
+      changed_[i * 2 + 1] = true;
+    }
+  }
+}
+
+void OsdProgressBar::SetVisible(bool visible) {
+  if (visible_ != visible) {
+    visible_ = visible;
+    changed_.assign(changed_.size(), true);
+  }
+}
+
+void OsdProgressBar::TakeChangedCells(std::vector<OverlayCell>& cells, size_t xpos, size_t ypos) {
+  const TileRect& shade = glyphs_.GetGlyphRect(GlyphAtlas::kShadeGlyph);
+  const TileRect& fill = glyphs_.GetGlyphRect(GlyphAtlas::kFillGlyph);
+  float y = ypos + y_;
+  for (size_t i = 0; i < fill_.size(); ++i) {
+    float x = xpos + x_ + GetSegmentX(i);
+    // Ячейки фона и заполнения идут парами: фон рисуется первым
+    if (changed_[i * 2]) {
+      changed_[i * 2] = false;
+      OverlayCell cell = {first_cell_ + i * 2, MakeCellQuad(shade, x, y,
+          visible_ ? GetSegmentWidth(i) : 0.0f, height_)};
+      cells.push_back(cell);
+    }
+    if (changed_[i * 2 + 1]) {
+      changed_[i * 2 + 1] = false;
+      OverlayCell cell = {first_cell_ + i * 2 + 1, MakeCellQuad(fill, x, y,
+          visible_ ? fill_[i] : 0.0f, height_)};
+      cells.push_back(cell);
+    }
+  }
+}
+
+size_t OsdProgressBar::GetSegmentX(size_t index) const {
+  return index * (width_ / fill_.size());
+}
+
+size_t OsdProgressBar::GetSegmentWidth(size_t index) const {
+  // Последний сегмент забирает остаток ширины
+  if (index + 1 == fill_.size()) {
+    return width_ - GetSegmentX(index);
+  }
+  return width_ / fill_.size();
+}
+
+
+OsdGraph::OsdGraph(const GlyphAtlas& glyphs, size_t first_cell, size_t columns,
+    size_t x, size_t y, size_t width, size_t height): glyphs_(glyphs),
+    first_cell_(first_cell), x_(x), y_(y), width_(width), height_(height),
+    fill_(columns, 0), changed_(columns * 2, true), visible_(false) {
+  assert(columns > 0 && first_cell + columns * 2 <= kOverlayCellCount);
+  assert(width / columns > kColumnGap);
+}
+
+void OsdGraph::AddValue(float value) {
+  value = std::max(0.0f, std::min(value, 1.0f));
+  size_t fill = static_cast<size_t>(value * height_ + 0.5f);
+  // Сдвигаются значения, ячейки остаются на месте: меняются только столбцы
+  // с другой высотой
+  for (size_t i = 0; i < fill_.size(); ++i) {
+    size_t next = i + 1 < fill_.size() ? fill_[i + 1] : fill;
+    if (fill_[i] != next) {
+      fill_[i] = next;
+      changed_[i * 2 + 1] = true;
+    }
+  }
+}
+
+void OsdGraph::SetVisible(bool visible) {
+  if (visible_ != visible) {
+    visible_ = visible;
+    changed_.assign(changed_.size(), true);
+  }
+}
+
+void OsdGraph::TakeChangedCells(std::vector<OverlayCell>& cells, size_t xpos, size_t ypos) {
+  const TileRect& shade = glyphs_.GetGlyphRect(GlyphAtlas::kShadeGlyph);
+  const TileRect& fill = glyphs_.GetGlyphRect(GlyphAtlas::kFillGlyph);
+  size_t step = width_ / fill_.size();
+  float width = step - kColumnGap;
+  float bottom = ypos + y_ + height_;
+  for (size_t i = 0; i < fill_.size(); ++i) {
+    float x = xpos + x_ + i * step;
+    // Ячейки фона и заполнения идут парами: фон рисуется первым
+    if (changed_[i * 2]) {
+      changed_[i * 2] = false;
+      OverlayCell cell = {first_cell_ + i * 2, MakeCellQuad(shade, x, bottom - height_,
+          visible_ ? width : 0.0f, height_)};
+      cells.push_back(cell);
+    }
+    if (changed_[i * 2 + 1]) {
+      changed_[i * 2 + 1] = false;
+      OverlayCell cell = {first_cell_ + i * 2 + 1, MakeCellQuad(fill, x, bottom - fill_[i],
+          visible_ ? width : 0.0f, fill_[i])};
+      cells.push_back(cell);
+    }
+  }
+}
@@ -0,0 +1,64 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "overlay.h"
+
+#include <algorithm>
+
+namespace {
+
+const size_t kAtlasWidth = 512;
+const size_t kAtlasPadding = 2; //!< Прозрачный зазор между картинками, чтобы при фильтрации не подмешивались соседние
+
+} // namespace
+
+
+void BuildOverlayAtlas(std::vector<uint32_t>& pixels, size_t& width, size_t& height,
+    const std::vector<const TileImage*>& images, std::vector<TileRect>& rects) {
+  // Раскладываем картинки по полкам: сначала самые высокие
+  std::vector<size_t> order(images.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&images](size_t a, size_t b) {
+    return images[a]->height > images[b]->height;
+  });
+
+  rects.assign(images.size(), TileRect{0, 0, 0, 0});
+  size_t shelf_x = kAtlasPadding;
+  size_t shelf_y = kAtlasPadding;
+  size_t shelf_height = 0;
+  for (auto index: order) {
+    auto img = images[index];
+    if (shelf_x + img->width + kAtlasPadding > kAtlasWidth) {
+      shelf_x = kAtlasPadding;
+      shelf_y += shelf_height + kAtlasPadding;
+      shelf_height = 0;
+    }
+    rects[index] = TileRect{shelf_x, shelf_y, img->width, img->height};
+    shelf_x += img->width + kAtlasPadding;
+    shelf_height = std::max(shelf_height, img->height);
+  }
+
+  width = kAtlasWidth;
+  height = shelf_y + shelf_height + kAtlasPadding;
+  pixels.assign(width * height, 0);
+  for (size_t i = 0; i < images.size(); ++i) {
+    AddTile(pixels, width, *images[i], rects[i].x, rects[i].y, rects[i]);
+  }
+}
@@ -0,0 +1,200 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "program_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QSaveFile>
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+const char ProgramBinaryCache::kSignature[] = "PSVRPRG1";
+
+namespace {
+
+const int kSignatureSize = 8;
+const int kHeaderSize = kSignatureSize + 4; //!< Подпись и формат программы
+const int kMaxDriverDirectories = 4; //!< Столько последних использованных драйверов хранится
+const char kUsedStampName[] = "used"; //!< Файл в каталоге драйвера, время изменения - время использования
+
+QDateTime GetLastUse(const QFileInfo& driver_directory) {
+  QFileInfo stamp(QDir(driver_directory.filePath()).filePath(kUsedStampName));
+  return stamp.exists() ? stamp.lastModified() : driver_directory.lastModified();
+}
+
+QString GetHash(const QByteArray& data) {
+  return QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex());
+}
+
+} // namespace
+
+
+ProgramBinaryCache::ProgramBinaryCache(const QString& directory): directory_(directory),
+    initialized_(false), enabled_(false) {
+}
+
+bool ProgramBinaryCache::Init() {
+  if (initialized_) {
+    return enabled_;
+  }
+  initialized_ = true;
+
+  auto context = QOpenGLContext::currentContext();
+  if (directory_.isEmpty() || !context) {
+    return false;
+  }
+  auto surface_format = context->format();
+  bool supported = (surface_format.majorVersion() > 4 ||
+      (surface_format.majorVersion() == 4 && surface_format.minorVersion() >= 1)) ||
+      context->hasExtension("GL_ARB_get_program_binary");
+  auto gl = context->extraFunctions();
+  GLint formats = 0;
+  if (supported) {
+    gl->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+  }
+  if (formats <= 0) {
+    printf("Shader cache is disabled: the driver doesn't support program binaries\n");
+    return false;
+  }
+
+  QByteArray driver;
+  for (GLenum name: {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+    auto value = gl->glGetString(name);
+    driver += QByteArray(value ? reinterpret_cast<const char*>(value) : "") + '\n';
+  }
+  QString driver_hash = GetHash(driver);
+
+  QDir dir(directory_);
+  driver_directory_ = dir.filePath(driver_hash);
+  QFile stamp(QDir(driver_directory_).filePath(kUsedStampName));
+  if (!QDir().mkpath(driver_directory_) || !stamp.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+      stamp.write(driver) != driver.size()) {
+    printf("Shader cache is disabled: can't create %s\n", driver_directory_.toStdString().c_str());
+    return false;
+  }
+  stamp.close();
+
+  // На одной машине могут работать несколько драйверов (гибридная графика,
+  // llvmpipe в psvr_render_bench), поэтому каталоги других драйверов
+  // остаются. Удаляются только давно не использованные сверх kMaxDriverDirectories
+  auto drivers = dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+  std::sort(drivers.begin(), drivers.end(), [](const QFileInfo& a, const QFileInfo& b) {
+    return GetLastUse(a) > GetLastUse(b);
+  });
+  for (int i = kMaxDriverDirectories; i < drivers.size(); ++i) {
+    if (drivers[i].fileName() != driver_hash) {
+      QDir(drivers[i].filePath()).removeRecursively();
+    }
+  }
+
+  enabled_ = true;
+  return true;
+}
+
+QString ProgramBinaryCache::GetFileName(const QByteArray& key) const {
+  return QDir(driver_directory_).filePath(GetHash(key) + ".bin");
+}
+
+bool ProgramBinaryCache::Load(QOpenGLShaderProgram* program, const QByteArray& key) {
+  if (!Init()) {
+    return false;
+  }
+
+  QFile file(GetFileName(key));
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+  QByteArray data = file.readAll();
+  file.close();
+  if (data.size() <= kHeaderSize || memcmp(data.constData(), kSignature, kSignatureSize) != 0) {
+    file.remove();
+    return false;
+  }
+
+  GLenum binary_format;
+  memcpy(&binary_format, data.constData() + kSignatureSize, sizeof(binary_format));
+  auto gl = QOpenGLContext::currentContext()->extraFunctions();
+  program->create();
+  gl->glProgramBinary(program->programId(), binary_format, data.constData() + kHeaderSize,
+      data.size() - kHeaderSize);
+  // Программа без шейдеров проверяется по состоянию сборки
+  if (!program->link()) {
+    // Драйвер может отказаться от программы, например после обновления
+    file.remove();
+    return false;
+  }
+  return true;
+}
+
+void ProgramBinaryCache::PrepareLink(QOpenGLShaderProgram* program) {
+  if (!Init()) {
+    return;
+  }
+  auto gl = QOpenGLContext::currentContext()->extraFunctions();
+  gl->glProgramParameteri(program->programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramBinaryCache::Save(QOpenGLShaderProgram* program, const QByteArray& key) {
+  if (!Init() || !program->isLinked()) {
+    return;
+  }
+
+  auto gl = QOpenGLContext::currentContext()->extraFunctions();
+  GLint length = 0;
+  gl->glGetProgramiv(program->programId(), GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+  QByteArray data(kHeaderSize + length, '\0');
+  GLenum binary_format = 0;
+  GLsizei written = 0;
+  gl->glGetProgramBinary(program->programId(), length, &written, &binary_format,
+      data.data() + kHeaderSize);
+  if (written <= 0) {
+    return;
+  }
+  memcpy(data.data(), kSignature, kSignatureSize);
+  memcpy(data.data() + kSignatureSize, &binary_format, sizeof(binary_format));
+  data.resize(kHeaderSize + written);
+
+  // Файл заменяется целиком, чтобы параллельный запуск не прочитал его часть
+  QSaveFile file(GetFileName(key));
+  if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+    printf("Failed to save shader cache %s\n", file.fileName().toStdString().c_str());
+  }
+}
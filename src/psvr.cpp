@@ -21,28 +21,37 @@
 #include <cstdint>
 #include <cstring>
 
+#include <QQuaternion>
+
 #include "psvr.h"
+#include "imu.h"
 
 
 
 #define MAX_STR			255
 
-int16_t read_int16(unsigned char *buffer, int offset);
-
 #define PSVR_VENDOR_ID	0x054c
 #define PSVR_PRODUCT_ID	0x09af
 
-#define ACCELERATION_COEF 0.00003125f
-
 PsvrSensors::PsvrSensors(): x_velo_(0.0), y_velo_(0.0), z_velo_(0.0),
-    x_angle_(0.0), y_angle_(0.0), z_angle_(0.0), run_reading_(false) {
-  device_ = 0;
-	memset(buffer, 0, sizeof(buffer));
+    orientation_(kIdentityQuaternion), angular_velocity_{0.0, 0.0, 0.0},
+    run_reading_(false), device_opened_(false), device_failed_(false), reader_priority_(0),
+    open_pending_(false), open_requested_(false), open_stop_(false),
+    replay_fast_(false), pose_sequence_(0), short_reads_(0), dropouts_(0) {
+  connect(&update_notifier_, SIGNAL(Notified()), this, SIGNAL(SensorUpdate()));
   ResetView(false);
+  open_thr_ = std::thread([this](){ WorkOpen(); });
 }
 
 PsvrSensors::~PsvrSensors()
 {
+  {
+    std::lock_guard<std::mutex> lk(open_lock_);
+    open_stop_ = true;
+    open_cv_.notify_all();
+  }
+  open_thr_.join();
+  CloseDevice();
 }
 
 hid_device_info *PsvrSensors::EnumerateDevices()
@@ -52,28 +61,111 @@ hid_device_info *PsvrSensors::EnumerateDevices()
 }
 
 bool PsvrSensors::OpenDevice() {
-  CloseDevice();
-  assert(!device_);
+  std::string path = GetSensorDevice();
+  return OpenDevice(path, GetSerial());
+}
 
-  auto dev_name = GetSensorDevice();
-  if (dev_name.empty()) {
-    return false;
+bool PsvrSensors::OpenDevice(const std::string& hid_path, const std::string& serial) {
+  std::lock_guard<std::mutex> lk(device_lock_);
+  return Open(hid_path, serial);
+}
+
+void PsvrSensors::CloseDevice() {
+  std::lock_guard<std::mutex> lk(device_lock_);
+  Close();
+}
+
+void PsvrSensors::RequestOpen(const std::string& hid_path, const std::string& serial) {
+  std::lock_guard<std::mutex> lk(open_lock_);
+  open_pending_ = true;
+  open_requested_ = true;
+  open_path_ = hid_path;
+  open_serial_ = serial;
+  open_cv_.notify_all();
+}
+
+void PsvrSensors::RequestClose() {
+  std::lock_guard<std::mutex> lk(open_lock_);
+  open_pending_ = true;
+  open_requested_ = false;
+  open_cv_.notify_all();
+}
+
+std::string PsvrSensors::GetSerial() const {
+  std::lock_guard<std::mutex> lk(serial_lock_);
+  return serial_;
+}
+
+void PsvrSensors::WorkOpen() {
+  while (true) {
+    bool open;
+    std::string path, serial;
+    {
+      std::unique_lock<std::mutex> lk(open_lock_);
+      open_cv_.wait(lk, [this](){ return open_stop_ || open_pending_; });
+      if (open_stop_) {
+        break;
+      }
+      open_pending_ = false;
+      open = open_requested_;
+      path = open_path_;
+      serial = open_serial_;
+    }
+
+    std::lock_guard<std::mutex> lk(device_lock_);
+    if (open) {
+      emit DeviceOpened(Open(path, serial));
+    } else {
+      Close();
+    }
   }
+}
 
-  device_ = hid_open_path(dev_name.c_str());
+bool PsvrSensors::Open(const std::string& hid_path, const std::string& serial) {
+  Close();
+  assert(!device_);
+
+  {
+    std::lock_guard<std::mutex> lk(serial_lock_);
+    serial_ = serial;
+  }
+  if (latency_probe_) {
+    device_ = OpenStepSensorDevice(latency_probe_);
+  } else if (replay_file_.empty()) {
+    // hidraw backend doesn't need hidapi path, so the path can be empty
+    device_ = OpenSensorDevice(hid_path);
+  } else {
+    device_ = OpenReplaySensorDevice(replay_file_, replay_fast_);
+  }
+  device_ = MakeRecordingSensorDevice(std::move(device_), recorder_);
   if (!device_) {
     return false;
   }
 
   run_reading_ = true;
-  std::thread rthr([this](){
+  device_failed_ = false;
+  device_opened_ = true;
+  last_report_ = decltype(last_report_)();
+  int priority = reader_priority_;
+  std::thread rthr([this, priority](){
+    if (!SetRealtimePriority(priority)) {
+      fprintf(stderr, "Failed to set realtime priority %d for sensors reading\n", priority);
+    }
+
+    // Every wakeup drains all queued reports
+    std::vector<SensorReport> reports;
     while (run_reading_) {
-      if (Read(kReadTimeoutMs)) {
-        emit SensorUpdate();
+      reports.clear();
+      if (!device_->WaitReports(reports, kReadTimeoutMs)) {
+        device_failed_ = true;
+        ++dropouts_;
+        emit DeviceFailed();
+        break;
+      }
+      if (!reports.empty()) {
+        ProcessReports(reports);
+        update_notifier_.Notify();
       }
-
-      std::this_thread::sleep_for(std::chrono::microseconds(kReadIntervalMcs));
-
     }
   });
 
@@ -83,61 +175,99 @@ bool PsvrSensors::OpenDevice() {
 }
 
 
-void PsvrSensors::CloseDevice()
+void PsvrSensors::SetSession(std::shared_ptr<SessionRecorder> recorder,
+    const std::string& replay_file, bool replay_fast) {
+  recorder_ = recorder;
+  replay_file_ = replay_file;
+  replay_fast_ = replay_fast;
+}
+
+void PsvrSensors::Close()
 {
+  device_opened_ = false;
   if (read_thr_.joinable()) {
     run_reading_ = false;
+    device_->Interrupt();
     read_thr_.join();
-  }
 
-  if(!device_)
-		return;
+    uint64_t loads, retries;
+    pose_.GetStatistics(loads, retries);
+    printf("Sensors reader (%s) is stopped. Pose reads: %llu, retries: %llu\n%s", device_->GetName(),
+        static_cast<unsigned long long>(loads), static_cast<unsigned long long>(retries),
+        FormatStatistics().c_str());
+  }
 
-  hid_close(device_);
-  device_ = 0;
+  device_.reset();
 }
 
-bool PsvrSensors::Read(int timeout)
+void PsvrSensors::ProcessReports(const std::vector<SensorReport>& reports)
 {
-  if(!device_)
-		return false;
-
-  int size = hid_read_timeout(device_, buffer, PSVR_BUFFER_SIZE, timeout);
-  auto ct = std::chrono::steady_clock::now();
-	
-  if(size != 64) {
-    // Device is switched off
-    // printf("read failed \"%S\"\n", hid_error(psvr_device));
-    return false;
+  // Fast replay stamps reports with the recorded time, which runs ahead of
+  // the clock: the time is integrated, but latencies aren't measured
+  bool measure_latency = replay_file_.empty() || !replay_fast_;
+  for (auto& report: reports) {
+    if (measure_latency && last_report_ != decltype(last_report_)()) {
+      report_interval_.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+          report.time - last_report_).count());
+    }
+    last_report_ = report.time;
   }
 
+  auto ct = reports.back().time;
   if (last_reading_ == decltype(last_reading_)()) {
     // last_reading_ isn't valid. reset view and store current value
     last_reading_ = ct;
+    {
+      std::lock_guard<std::mutex> lk(angle_lock_);
+      integrator_.Reset();
+    }
     ResetView(false);
-    return true;
+    return;
   }
-
-  double ims = std::chrono::duration_cast<std::chrono::microseconds>
-      (ct - last_reading_).count() * 0.001;
   last_reading_ = ct;
 
-  // printf("Read sensors in interval %.1f\n", ims);
-
-  int16_t y_acc = read_int16(buffer, 20) + read_int16(buffer, 36);
-  int16_t x_acc = read_int16(buffer, 22) + read_int16(buffer, 38);
-  int16_t z_acc = read_int16(buffer, 24) + read_int16(buffer, 40);
-
+  // Every sample is integrated over its own interval by device timestamps
+  ImuSample samples[kImuSamplesPerReport];
   std::unique_lock<std::mutex> alocker(angle_lock_);
-  double delta_x_angle = (-x_acc * ACCELERATION_COEF - x_velo_) * ims;
-  double delta_y_angle = (-y_acc * ACCELERATION_COEF - y_velo_) * ims;
-  double delta_z_angle = (-z_acc * ACCELERATION_COEF - z_velo_) * ims;
-  x_angle_ += delta_x_angle;
-  y_angle_ += delta_y_angle;
-  z_angle_ += delta_z_angle;
-
+  double velo[3] = {x_velo_, y_velo_, z_velo_};
+  uint32_t last_tick = 0;
+  for (auto& report: reports) {
+    size_t count = ParseSensorReport(report.data, report.size, samples);
+    if (count == 0) {
+      ++short_reads_;
+    }
+    for (size_t i = 0; i < count; ++i) {
+      double bias[3];
+      if (still_detector_.AddSample(samples[i], bias)) {
+        // The helmet lies still: its angle speed is the gyro bias. Only the
+        // learned bias is limited, compensation set by the user is kept
+        for (size_t j = 0; j < 3; ++j) {
+          velo[j] += (ClampGyroBias(bias[j]) - velo[j]) * kBiasUpdateRate;
+        }
+        x_velo_ = velo[0];
+        y_velo_ = velo[1];
+        z_velo_ = velo[2];
+      }
+      if (integrator_.Integrate(samples[i], velo, orientation_) > 0.0) {
+        GetAngularVelocity(samples[i], velo, angular_velocity_);
+      }
+      last_tick = samples[i].tick;
+    }
+  }
+  auto pt = PublishPose(ct);
+  auto sequence = pose_sequence_;
   alocker.unlock();
-  return true;
+
+  if (latency_probe_) {
+    latency_probe_->Publish(last_tick, sequence);
+  }
+
+  if (measure_latency) {
+    for (auto& report: reports) {
+      publish_latency_.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+          pt - report.time).count());
+    }
+  }
 }
 
 void PsvrSensors::ResetView(bool apply_compensation)
@@ -151,9 +281,11 @@ void PsvrSensors::ResetView(bool apply_compensation)
     double ims = std::chrono::duration_cast<std::chrono::microseconds>
         (ct - last_reset_view_).count() * 0.001;
     if (apply_compensation && (ims > kMinimumCompensationIntervalMs)) {
-      double extra_x_velo = x_angle_ / ims;
-      double extra_y_velo = y_angle_ / ims;
-      double extra_z_velo = z_angle_ / ims;
+      double angles[3];
+      GetRotationAngles(orientation_, angles);
+      double extra_x_velo = angles[0] / ims;
+      double extra_y_velo = angles[1] / ims;
+      double extra_z_velo = angles[2] / ims;
       x_velo_ = x_velo_ + extra_x_velo * kCompensationRough;
       y_velo_ = y_velo_ + extra_y_velo * kCompensationRough;
       z_velo_ = z_velo_ + extra_z_velo * kCompensationRough;
@@ -162,26 +294,43 @@ void PsvrSensors::ResetView(bool apply_compensation)
   }
 
   // Reset view
-  x_angle_ = 0.0;
-  y_angle_ = 0.0;
-  z_angle_ = 0.0;
+  orientation_ = kIdentityQuaternion;
+  integrator_.ResetReference();
+  PublishPose(ct);
 }
 
-void PsvrSensors::GetModelViewMatrix(QMatrix4x4& matrix) {
-  double x, y, z;
-  std::unique_lock<std::mutex> lk(angle_lock_);
-  x = x_angle_;
-  y = y_angle_;
-  z = z_angle_;
-  lk.unlock();
+std::chrono::steady_clock::time_point PsvrSensors::PublishPose(std::chrono::steady_clock::time_point time) {
+  HelmetPose pose;
+  // Helmet turns to the right, so the view turns to the left: x and y axes
+  // are reverted. Tilt is rendered as is.
+  QQuaternion view(orientation_.w, -orientation_.x, -orientation_.y, orientation_.z);
+  pose.model_view.setToIdentity();
+  pose.model_view.rotate(view);
+  pose.orientation = orientation_;
+  for (size_t i = 0; i < 3; ++i) {
+    pose.velocity[i] = angular_velocity_[i];
+  }
+  pose.time = time;
+  pose.publish_time = std::chrono::steady_clock::now();
+  pose.sequence = ++pose_sequence_;
+  pose_.Store(pose);
+  return pose.publish_time;
+}
 
-  QMatrix4x4 m;
-  m.setToIdentity();
-  m.rotate(x, -1.0f, 0.0f, 0.0f);
-  m.rotate(y, 0.0f, -1.0f, 0.0f);
-  m.rotate(z, 0.0f, 0.0f, +1.0f);
+void PsvrSensors::GetPose(HelmetPose& pose) {
+  pose_.Load(pose);
+  pose_age_.Record(std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - pose.publish_time).count());
+}
 
-  matrix = m;
+std::string PsvrSensors::FormatStatistics() const {
+  char counters[128];
+  snprintf(counters, sizeof(counters), "Short reports: %llu, read failures: %llu\n",
+      static_cast<unsigned long long>(short_reads_.load()),
+      static_cast<unsigned long long>(dropouts_.load()));
+  return "Report interval: " + report_interval_.Format() + "\n" +
+      "Read to publish: " + publish_latency_.Format() + "\n" +
+      "Pose age: " + pose_age_.Format() + "\n" + counters;
 }
 
 void PsvrSensors::SetVelocity(double xvelocity, double yvelocity, double zvelocity) {
@@ -211,6 +360,14 @@ std::string PsvrSensors::GetSensorDevice() {
       std::string p = dev->path;
       if (p.substr(p.length() - 3) == kPsvrSensorInterface) {
         res = p;
+        std::lock_guard<std::mutex> lk(serial_lock_);
+        serial_.clear();
+        for (auto c = dev->serial_number; c && *c; ++c) {
+          // Serial is used as settings key, so only letters and digits are taken
+          if ((*c >= L'0' && *c <= L'9') || (*c >= L'A' && *c <= L'Z') || (*c >= L'a' && *c <= L'z')) {
+            serial_.push_back(static_cast<char>(*c));
+          }
+        }
         break;
       }
     }
@@ -222,11 +379,3 @@ std::string PsvrSensors::GetSensorDevice() {
 
   return res;
 }
-
-int16_t read_int16(unsigned char *buffer, int offset)
-{
-	int16_t v;
-	v = buffer[offset];
-	v |= buffer[offset+1] << 8;
-	return v;
-}
@@ -19,14 +19,37 @@
 #include "psvr_control.h"
 
 #include <cassert>
+#include <cstdio>
 #include <stdexcept>
+#include <vector>
 
 #include <hidapi/hidapi.h>
 
 
+namespace {
 
-PsvrControl::PsvrControl(): device_(nullptr) {
+const unsigned char kVRModeCommandId = 0x23;
+const unsigned char kPowerCommandId = 0x17;
 
+/*! Writing of one report by the writing thread. It's shared with the thread,
+because the thread outlives the control if the device hangs */
+struct WriteJob {
+  hid_device* device;
+  std::vector<unsigned char> data;
+  std::mutex lock;
+  std::condition_variable done_cv;
+  bool done = false;
+  int result = -1;
+};
+
+} // namespace
+
+
+PsvrControl::PsvrControl(): device_(nullptr), replay_opened_(false),
+    vr_mode_known_(false), vr_mode_(false), power_known_(false), power_(false),
+    replay_(false), opened_(false), session_replay_(false), callback_generation_(0),
+    stop_(false) {
+  worker_ = std::thread([this](){ Work(); });
 }
 
 
@@ -55,44 +78,161 @@ std::string PsvrControl::GetControlDevice() {
 }
 
 void PsvrControl::ReadCurrentSettings() {
-  // TODO I don't know how to do this
+  // The helmet can't report its settings, so they are unknown till the
+  // player sets them
+  vr_mode_known_ = false;
+  power_known_ = false;
+}
 
-//  buffer_[0] = 0x81;
-//  buffer_[1] = 0x00;
-//  buffer_[2] = 0xaa;
-//  buffer_[3] = 0x08;
-//  buffer_[4] = ;
-//  buffer_[5] = ;
-//  buffer_[6] = ;
-//  buffer_[7] = ;
-//  buffer_[8] = ;
-//  buffer_[1] = ;
-//  buffer_[1] = ;
+void PsvrControl::RestoreCurrentSettings() {
+  // Previous settings aren't known. The helmet is returned to cinematic mode,
+  // as it's switched on, if the player changed the mode
+  if (vr_mode_known_ && vr_mode_) {
+    WriteSetting(kVRModeCommandId, false, vr_mode_known_, vr_mode_);
+  }
+}
 
 
-//  auto res = hid_write((hid_device*)device_,buffer_, kMaxBufferSize);
-//  int k = 0;
+PsvrControl::~PsvrControl() {
+  CloseDevice();
+  {
+    std::lock_guard<std::mutex> lk(lock_);
+    stop_ = true;
+    queue_cv_.notify_all();
+  }
+  worker_.join();
 }
 
-void PsvrControl::RestoreCurrentSettings() {
-  // TODO I don't know how to do this
+void PsvrControl::OpenDevice(Callback callback) {
+  Enqueue(kOpenCommand, true, std::string(), callback);
 }
 
+void PsvrControl::OpenDevice(const std::string& hid_path, Callback callback) {
+  Enqueue(kOpenCommand, true, hid_path, callback);
+}
 
-PsvrControl::~PsvrControl() {
+void PsvrControl::CloseDevice(Callback callback) {
+  Enqueue(kCloseCommand, false, std::string(), callback);
+}
 
+bool PsvrControl::IsOpened()
+{
+  return opened_;
 }
 
-bool PsvrControl::OpenDevice() {
+void PsvrControl::SetVRMode(bool vrmode, Callback callback)
+{
+  Enqueue(kVRModeCommand, vrmode, std::string(), callback);
+}
+
+void PsvrControl::SetPower(bool on, Callback callback) {
+  Enqueue(kPowerCommand, on, std::string(), callback);
+}
+
+void PsvrControl::ClearCallbacks() {
+  {
+    std::lock_guard<std::mutex> lk(lock_);
+    ++callback_generation_;
+    for (auto& cmd: queue_) {
+      cmd.callbacks.clear();
+    }
+  }
+  // Waits for the running callback
+  std::lock_guard<std::mutex> lk(callback_lock_);
+}
+
+void PsvrControl::SetSession(std::shared_ptr<SessionRecorder> recorder, bool replay) {
   CloseDevice();
+  std::lock_guard<std::mutex> lk(lock_);
+  session_recorder_ = recorder;
+  session_replay_ = replay;
+}
+
+void PsvrControl::Enqueue(CommandType type, bool value, const std::string& path, Callback callback) {
+  std::lock_guard<std::mutex> lk(lock_);
+  if (queue_.empty() || queue_.back().type != type) {
+    queue_.push_back(Command());
+    queue_.back().type = type;
+  }
+  Command& cmd = queue_.back();
+  cmd.value = value;
+  cmd.path = path;
+  cmd.deadline = std::chrono::steady_clock::now() + kCommandTimeout;
+  if (callback) {
+    cmd.callbacks.push_back(callback);
+  }
+  cmd.generation = callback_generation_;
+  queue_cv_.notify_all();
+}
+
+void PsvrControl::Work() {
+  while (true) {
+    Command cmd;
+    {
+      std::unique_lock<std::mutex> lk(lock_);
+      queue_cv_.wait(lk, [this](){ return stop_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        // Stopped and all commands are executed
+        break;
+      }
+      cmd = std::move(queue_.front());
+      queue_.pop_front();
+      recorder_ = session_recorder_;
+      replay_ = session_replay_;
+    }
+
+    bool res = false;
+    if (std::chrono::steady_clock::now() > cmd.deadline) {
+      fprintf(stderr, "Control command %d is timed out in the queue\n", static_cast<int>(cmd.type));
+    } else {
+      res = Execute(cmd);
+    }
+    opened_ = device_ || replay_opened_;
+
+    std::lock_guard<std::mutex> clk(callback_lock_);
+    {
+      std::lock_guard<std::mutex> lk(lock_);
+      if (cmd.generation != callback_generation_) {
+        continue;
+      }
+    }
+    for (auto& callback: cmd.callbacks) {
+      callback(res);
+    }
+  }
+  Close();
+}
+
+bool PsvrControl::Execute(const Command& cmd) {
+  switch (cmd.type) {
+    case kOpenCommand:
+      return Open(cmd.path);
+    case kCloseCommand:
+      Close();
+      return true;
+    case kVRModeCommand:
+      return WriteSetting(kVRModeCommandId, cmd.value, vr_mode_known_, vr_mode_);
+    case kPowerCommand:
+      return WriteSetting(kPowerCommandId, cmd.value, power_known_, power_);
+  }
+  return false;
+}
+
+bool PsvrControl::Open(const std::string& hid_path) {
+  Close();
   assert(!device_);
 
-  auto dev_name = GetControlDevice();
-  if (dev_name.empty()) {
+  if (replay_) {
+    replay_opened_ = true;
+    return true;
+  }
+
+  std::string path = hid_path.empty() ? GetControlDevice() : hid_path;
+  if (path.empty()) {
     return false;
   }
 
-  device_ = hid_open_path(dev_name.c_str());
+  device_ = hid_open_path(path.c_str());
   if (!device_) {
     return false;
   }
@@ -102,29 +242,83 @@ bool PsvrControl::OpenDevice() {
   return true;
 }
 
-void PsvrControl::CloseDevice() {
-  if (device_) {
+void PsvrControl::Close() {
+  if (replay_opened_ || device_) {
     RestoreCurrentSettings();
+  }
+  replay_opened_ = false;
+  vr_mode_known_ = false;
+  power_known_ = false;
+  if (device_) {
     hid_close((hid_device*)device_);
     device_ = nullptr;
   }
 }
 
-bool PsvrControl::IsOpened()
-{
-  return device_;
-}
+bool PsvrControl::WriteSetting(unsigned char id, bool value, bool& known, bool& current) {
+  if (!device_ && !replay_opened_) {
+    return false;
+  }
+  if (known && current == value) {
+    // The setting is applied already
+    return true;
+  }
 
-bool PsvrControl::SetVRMode(bool vrmode)
-{
-  buffer_[0] = 0x23;
+  buffer_[0] = id;
   buffer_[1] = 0x00;
   buffer_[2] = 0xaa;
   buffer_[3] = 0x04;
-  buffer_[4] = vrmode ? 0x01 : 0x00;
+  buffer_[4] = value ? 0x01 : 0x00;
   buffer_[5] = 0x00;
   buffer_[6] = 0x00;
   buffer_[7] = 0x00;
 
-  return hid_write((hid_device*)device_, buffer_, 8) != -1;
+  known = WriteCommand(8);
+  current = value;
+  return known;
+}
+
+bool PsvrControl::WriteCommand(size_t size) {
+  if (recorder_) {
+    recorder_->WriteCommand(buffer_, size);
+  }
+
+  if (replay_) {
+    printf("Control command:");
+    for (size_t i = 0; i < size; ++i) {
+      printf(" %02x", buffer_[i]);
+    }
+    printf("\n");
+    return replay_opened_;
+  }
+
+  // hid_write has no timeout, so it's called by a separate thread
+  for (int i = 0; i < kWriteAttempts; ++i) {
+    if (i > 0) {
+      std::this_thread::sleep_for(kRetryDelay);
+    }
+    auto job = std::make_shared<WriteJob>();
+    job->device = (hid_device*)device_;
+    job->data.assign(buffer_, buffer_ + size);
+    std::thread([job](){
+      int res = hid_write(job->device, job->data.data(), job->data.size());
+      std::lock_guard<std::mutex> lk(job->lock);
+      job->result = res;
+      job->done = true;
+      job->done_cv.notify_all();
+    }).detach();
+
+    std::unique_lock<std::mutex> lk(job->lock);
+    if (!job->done_cv.wait_for(lk, kWriteTimeout, [&job](){ return job->done; })) {
+      // The hung thread still uses the device, so it isn't closed
+      fprintf(stderr, "Control interface doesn't respond in %d ms, it's abandoned\n",
+          static_cast<int>(kWriteTimeout.count()));
+      device_ = nullptr;
+      return false;
+    }
+    if (job->result != -1) {
+      return true;
+    }
+  }
+  return false;
 }
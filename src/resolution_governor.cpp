@@ -0,0 +1,108 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "resolution_governor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+ResolutionGovernor::ResolutionGovernor(): min_scale_(1.0f), max_scale_(1.0f), scale_(1.0f),
+    budget_us_(0) {
+  ResetCounters();
+}
+
+void ResolutionGovernor::SetBounds(float min_scale, float max_scale) {
+  min_scale_ = std::min(min_scale, max_scale);
+  max_scale_ = max_scale;
+  scale_ = std::max(min_scale_, std::min(scale_, max_scale_));
+  ResetCounters();
+}
+
+void ResolutionGovernor::SetFrameBudget(uint64_t budget_us) {
+  if (budget_us_ != budget_us) {
+    budget_us_ = budget_us;
+    ResetCounters();
+  }
+}
+
+bool ResolutionGovernor::AddFrame(uint64_t scaled_us, uint64_t fixed_us) {
+  if (budget_us_ == 0 || min_scale_ == max_scale_) {
+    return false;
+  }
+  if (settle_count_ > 0) {
+    --settle_count_;
+    return false;
+  }
+  if (fixed_us >= budget_us_) {
+    // Кадр не укладывается и без глаз, масштаб тут не поможет
+    ResetCounters();
+    return false;
+  }
+
+  uint64_t left_us = budget_us_ - fixed_us;
+  double load = static_cast<double>(scaled_us) / left_us;
+  if (load > kHighLoad) {
+    underload_count_ = 0;
+    overload_sum_ += scaled_us;
+    overload_left_sum_ += left_us;
+    if (++overload_count_ < kOverloadFrames || scale_ <= min_scale_) {
+      return false;
+    }
+    // Время глаз пропорционально числу пикселей, то есть квадрату масштаба
+    double average = static_cast<double>(overload_sum_) / overload_count_;
+    double left = static_cast<double>(overload_left_sum_) / overload_count_;
+    float scale = scale_ * static_cast<float>(std::sqrt(kTargetLoad * left / average));
+    scale = std::floor(scale / kScaleStep) * kScaleStep;
+    scale = std::max(min_scale_, std::min(scale, scale_ - kScaleStep));
+    ChangeScale(scale, "over", kHighLoad, average, left);
+    return true;
+  }
+
+  overload_count_ = 0;
+  overload_sum_ = 0;
+  overload_left_sum_ = 0;
+  if (load < kLowLoad) {
+    if (++underload_count_ < kUnderloadFrames || scale_ >= max_scale_) {
+      return false;
+    }
+    float scale = std::round(scale_ / kScaleStep + 1.0f) * kScaleStep;
+    ChangeScale(std::min(max_scale_, scale), "under", kLowLoad, scaled_us, left_us);
+    return true;
+  }
+  underload_count_ = 0;
+  return false;
+}
+
+void ResolutionGovernor::ChangeScale(float scale, const char* reason, double load,
+    double scaled_us, double left_us) {
+  printf("Eye buffer scale %.2f -> %.2f: eyes take %.2f ms on GPU, %s %.0f%% of %.2f ms left "
+      "in %.2f ms frame\n", scale_, scale, scaled_us * 0.001, reason, load * 100.0,
+      left_us * 0.001, budget_us_ * 0.001);
+  scale_ = scale;
+  ResetCounters();
+  settle_count_ = kSettleFrames;
+}
+
+void ResolutionGovernor::ResetCounters() {
+  overload_count_ = 0;
+  overload_sum_ = 0;
+  overload_left_sum_ = 0;
+  underload_count_ = 0;
+  settle_count_ = 0;
+}
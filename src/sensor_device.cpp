@@ -0,0 +1,258 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "sensor_device.h"
+
+#include <hidapi/hidapi.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#endif
+
+namespace {
+
+/*! Portable backend: polls hidapi with timeout */
+class HidapiSensorDevice: public SensorDevice {
+ public:
+  explicit HidapiSensorDevice(hid_device* device): device_(device) {}
+  ~HidapiSensorDevice() { hid_close(device_); }
+
+  bool WaitReports(std::vector<SensorReport>& reports, int timeout_ms) override {
+    SensorReport report;
+    int size = hid_read_timeout(device_, report.data, sizeof(report.data), timeout_ms);
+    while (size > 0) {
+      report.size = size;
+      report.time = std::chrono::steady_clock::now();
+      reports.push_back(report);
+      // Drain reports queued during processing of the previous wakeup
+      size = hid_read_timeout(device_, report.data, sizeof(report.data), 0);
+    }
+    return size == 0;
+  }
+
+  void Interrupt() override {}
+
+  const char* GetName() const override { return "hidapi"; }
+
+ private:
+  hid_device* device_;
+};
+
+
+#ifdef __linux__
+
+const char kPsvrHidId[] = ":054C:09AF."; //!< Part of HID device name: bus:vendor:product.instance
+const char kPsvrSensorInterface[] = "04";
+
+/*! Linux backend: reads hidraw node of the sensor interface, waits for
+reports in epoll and drains all queued reports per wakeup */
+class HidrawSensorDevice: public SensorDevice {
+ public:
+  HidrawSensorDevice(): fd_(-1), epoll_fd_(-1), event_fd_(-1) {}
+  ~HidrawSensorDevice() {
+    for (int fd: {fd_, epoll_fd_, event_fd_}) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+  }
+
+  bool Open(const std::string& node) {
+    fd_ = open(node.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd_ < 0 || epoll_fd_ < 0 || event_fd_ < 0) {
+      return false;
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd_;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd_, &ev) != 0) {
+      return false;
+    }
+    ev.data.fd = event_fd_;
+    return epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &ev) == 0;
+  }
+
+  bool WaitReports(std::vector<SensorReport>& reports, int timeout_ms) override {
+    epoll_event events[2];
+    int count = epoll_wait(epoll_fd_, events, 2, timeout_ms);
+    // Reports are stamped right after wakeup: it's the closest moment to their arrival
+    auto wakeup = std::chrono::steady_clock::now();
+    if (count < 0) {
+      return errno == EINTR;
+    }
+
+    for (int i = 0; i < count; ++i) {
+      if (events[i].data.fd == event_fd_) {
+        uint64_t value;
+        while (read(event_fd_, &value, sizeof(value)) > 0) {}
+      } else if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+        return false;
+      }
+    }
+
+    // hidraw returns one report per read
+    SensorReport report;
+    while (true) {
+      ssize_t size = read(fd_, report.data, sizeof(report.data));
+      if (size > 0) {
+        report.size = size;
+        report.time = wakeup;
+        reports.push_back(report);
+        continue;
+      }
+      if (size < 0 && errno == EINTR) {
+        continue;
+      }
+      // EAGAIN means the queue is drained. Other errors mean the device is lost
+      return size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+  }
+
+  void Interrupt() override {
+    uint64_t one = 1;
+    if (write(event_fd_, &one, sizeof(one)) < 0) {
+      // Counter overflow only: the reader is woken up anyway
+    }
+  }
+
+  const char* GetName() const override { return "hidraw"; }
+
+ private:
+  int fd_;
+  int epoll_fd_;
+  int event_fd_; //!< Used by Interrupt to wake up epoll_wait
+};
+
+/*! Finds /dev/hidrawN node of the helmet sensor interface through sysfs.
+hidapi path is the node itself for the hidraw backend and
+bus:address:interface in hex for the libusb one, then the node of the same USB
+device is taken. So with several helmets the sensors are read from the helmet
+of the path. Empty path takes the first sensor interface found
+\param hid_path hidapi path of the sensor interface
+\return node or empty string if it isn't found */
+std::string FindHidrawNode(const std::string& hid_path) {
+  if (hid_path.compare(0, 11, "/dev/hidraw") == 0) {
+    return hid_path;
+  }
+  unsigned int bus = 0;
+  unsigned int address = 0;
+  unsigned int iface_number = 0;
+  bool by_usb = sscanf(hid_path.c_str(), "%x:%x:%x", &bus, &address, &iface_number) == 3;
+  if (!hid_path.empty() && !by_usb) {
+    return std::string();
+  }
+
+  DIR* dir = opendir("/sys/class/hidraw");
+  if (!dir) {
+    return std::string();
+  }
+
+  std::string res;
+  while (auto entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (name.compare(0, 6, "hidraw") != 0) {
+      continue;
+    }
+
+    // device links to .../<usb interface>/<bus:vendor:product.instance>
+    char real[PATH_MAX];
+    std::string link = "/sys/class/hidraw/" + name + "/device";
+    if (!realpath(link.c_str(), real)) {
+      continue;
+    }
+    std::string hid = real;
+    if (hid.find(kPsvrHidId, hid.rfind('/')) == std::string::npos) {
+      continue;
+    }
+
+    std::ifstream f(hid + "/../bInterfaceNumber");
+    std::string iface;
+    if (!(f >> iface) || iface != kPsvrSensorInterface) {
+      continue;
+    }
+    if (by_usb) {
+      // busnum and devnum of the USB device are decimal
+      std::ifstream busf(hid + "/../../busnum");
+      std::ifstream devf(hid + "/../../devnum");
+      unsigned int busnum = 0;
+      unsigned int devnum = 0;
+      if (!(busf >> busnum) || !(devf >> devnum) || busnum != bus || devnum != address) {
+        continue;
+      }
+    }
+    res = "/dev/" + name;
+    break;
+  }
+  closedir(dir);
+  return res;
+}
+
+#endif
+
+} // namespace
+
+
+std::unique_ptr<SensorDevice> OpenSensorDevice(const std::string& hid_path) {
+#ifdef __linux__
+  auto node = FindHidrawNode(hid_path);
+  if (!node.empty()) {
+    std::unique_ptr<HidrawSensorDevice> dev(new HidrawSensorDevice());
+    if (dev->Open(node)) {
+      return dev;
+    }
+  }
+#endif
+
+  if (hid_path.empty()) {
+    return std::unique_ptr<SensorDevice>();
+  }
+  auto hid = hid_open_path(hid_path.c_str());
+  if (!hid) {
+    return std::unique_ptr<SensorDevice>();
+  }
+  return std::unique_ptr<SensorDevice>(new HidapiSensorDevice(hid));
+}
+
+bool SetRealtimePriority(int priority) {
+  if (priority <= 0) {
+    return true;
+  }
+#ifdef __linux__
+  sched_param param = {};
+  param.sched_priority = priority;
+  return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#else
+  return false;
+#endif
+}
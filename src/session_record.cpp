@@ -0,0 +1,237 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "session_record.h"
+
+#include <condition_variable>
+#include <cstring>
+
+namespace {
+
+const char kSessionSignature[] = "PSVRSES1";
+const size_t kSessionSignatureSize = 8;
+const size_t kRecordHeaderSize = 6;
+const size_t kFastReplayBatch = 8; //!< Reports per wakeup in fast replay, as if they were queued
+
+/*! Replays sensor reports of the session */
+class ReplaySensorDevice: public SensorDevice {
+ public:
+  explicit ReplaySensorDevice(bool fast): fast_(fast), has_next_(false), interrupted_(false) {}
+
+  bool Open(const std::string& fname) {
+    if (!reader_.Open(fname)) {
+      return false;
+    }
+    start_ = std::chrono::steady_clock::now();
+    ReadNextReport();
+    return true;
+  }
+
+  bool WaitReports(std::vector<SensorReport>& reports, int timeout_ms) override {
+    if (!has_next_) {
+      return false;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (fast_) {
+      // Time goes by reports only
+      for (size_t i = 0; i < kFastReplayBatch && has_next_; ++i) {
+        AddNextReport(reports);
+      }
+      return true;
+    }
+
+    auto deadline = now + std::chrono::milliseconds(timeout_ms);
+    auto due = GetNextTime();
+    {
+      std::unique_lock<std::mutex> lk(lock_);
+      cv_.wait_until(lk, due < deadline ? due : deadline, [this](){ return interrupted_; });
+      if (interrupted_) {
+        interrupted_ = false;
+        return true;
+      }
+    }
+
+    now = std::chrono::steady_clock::now();
+    while (has_next_ && GetNextTime() <= now) {
+      AddNextReport(reports);
+    }
+    return true;
+  }
+
+  void Interrupt() override {
+    std::lock_guard<std::mutex> lk(lock_);
+    interrupted_ = true;
+    cv_.notify_all();
+  }
+
+  const char* GetName() const override { return fast_ ? "replay (fast)" : "replay"; }
+
+ private:
+  bool fast_;
+  SessionReader reader_;
+  std::chrono::steady_clock::time_point start_;
+  SessionRecord next_;
+  bool has_next_;
+
+  std::mutex lock_;
+  std::condition_variable cv_;
+  bool interrupted_;
+
+  void ReadNextReport() {
+    // Control commands are written by the player itself, they aren't replayed
+    do {
+      has_next_ = reader_.Next(next_);
+    } while (has_next_ && next_.type != kSessionSensorReport);
+  }
+
+  std::chrono::steady_clock::time_point GetNextTime() const {
+    return start_ + std::chrono::microseconds(next_.time_us);
+  }
+
+  void AddNextReport(std::vector<SensorReport>& reports) {
+    SensorReport report;
+    report.size = next_.size < kSensorReportSize ? next_.size : kSensorReportSize;
+    memcpy(report.data, next_.data, report.size);
+    // Recorded time keeps replay deterministic in both modes
+    report.time = GetNextTime();
+    reports.push_back(report);
+    ReadNextReport();
+  }
+};
+
+/*! Passes reports of the device and writes them into the session */
+class RecordingSensorDevice: public SensorDevice {
+ public:
+  RecordingSensorDevice(std::unique_ptr<SensorDevice> device, std::shared_ptr<SessionRecorder> recorder):
+      device_(std::move(device)), recorder_(recorder), name_(device_->GetName()) {
+    name_ += " (recording)";
+  }
+
+  bool WaitReports(std::vector<SensorReport>& reports, int timeout_ms) override {
+    size_t first = reports.size();
+    bool res = device_->WaitReports(reports, timeout_ms);
+    for (size_t i = first; i < reports.size(); ++i) {
+      recorder_->WriteReport(reports[i]);
+    }
+    return res;
+  }
+
+  void Interrupt() override { device_->Interrupt(); }
+
+  const char* GetName() const override { return name_.c_str(); }
+
+ private:
+  std::unique_ptr<SensorDevice> device_;
+  std::shared_ptr<SessionRecorder> recorder_;
+  std::string name_;
+};
+
+} // namespace
+
+
+SessionRecorder::SessionRecorder(): last_time_us_(0) {
+}
+
+bool SessionRecorder::Open(const std::string& fname) {
+  std::lock_guard<std::mutex> lk(lock_);
+  file_.open(fname, std::ios_base::binary | std::ios_base::trunc);
+  file_.write(kSessionSignature, kSessionSignatureSize);
+  start_ = std::chrono::steady_clock::now();
+  last_time_us_ = 0;
+  return static_cast<bool>(file_);
+}
+
+void SessionRecorder::WriteReport(const SensorReport& report) {
+  WriteRecord(kSessionSensorReport, report.time, report.data, report.size);
+}
+
+void SessionRecorder::WriteCommand(const unsigned char* data, size_t size) {
+  WriteRecord(kSessionControlCommand, std::chrono::steady_clock::now(), data, size);
+}
+
+void SessionRecorder::WriteRecord(SessionRecordType type, std::chrono::steady_clock::time_point time,
+    const unsigned char* data, size_t size) {
+  std::lock_guard<std::mutex> lk(lock_);
+  if (!file_ || size > kMaxSessionRecordSize) {
+    return;
+  }
+
+  // Records of different threads can come a bit out of order: they get zero interval
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(time - start_).count();
+  uint64_t time_us = us > 0 ? static_cast<uint64_t>(us) : 0;
+  if (time_us < last_time_us_) {
+    time_us = last_time_us_;
+  }
+  uint64_t delta = time_us - last_time_us_;
+  if (delta > UINT32_MAX) {
+    delta = UINT32_MAX;
+  }
+  last_time_us_ += delta;
+
+  unsigned char header[kRecordHeaderSize] = {static_cast<unsigned char>(type),
+      static_cast<unsigned char>(size), static_cast<unsigned char>(delta & 0xff),
+      static_cast<unsigned char>((delta >> 8) & 0xff), static_cast<unsigned char>((delta >> 16) & 0xff),
+      static_cast<unsigned char>((delta >> 24) & 0xff)};
+  file_.write(reinterpret_cast<const char*>(header), kRecordHeaderSize);
+  file_.write(reinterpret_cast<const char*>(data), size);
+}
+
+
+SessionReader::SessionReader(): time_us_(0) {
+}
+
+bool SessionReader::Open(const std::string& fname) {
+  file_.open(fname, std::ios_base::binary);
+  char signature[kSessionSignatureSize];
+  if (!file_.read(signature, kSessionSignatureSize)) {
+    return false;
+  }
+  time_us_ = 0;
+  return memcmp(signature, kSessionSignature, kSessionSignatureSize) == 0;
+}
+
+bool SessionReader::Next(SessionRecord& record) {
+  unsigned char header[kRecordHeaderSize];
+  if (!file_.read(reinterpret_cast<char*>(header), kRecordHeaderSize)) {
+    return false;
+  }
+  record.type = static_cast<SessionRecordType>(header[0]);
+  record.size = header[1];
+  time_us_ += static_cast<uint32_t>(header[2]) | (static_cast<uint32_t>(header[3]) << 8) |
+      (static_cast<uint32_t>(header[4]) << 16) | (static_cast<uint32_t>(header[5]) << 24);
+  record.time_us = time_us_;
+  return static_cast<bool>(file_.read(reinterpret_cast<char*>(record.data), record.size));
+}
+
+
+std::unique_ptr<SensorDevice> OpenReplaySensorDevice(const std::string& fname, bool fast) {
+  std::unique_ptr<ReplaySensorDevice> dev(new ReplaySensorDevice(fast));
+  if (!dev->Open(fname)) {
+    return std::unique_ptr<SensorDevice>();
+  }
+  return dev;
+}
+
+std::unique_ptr<SensorDevice> MakeRecordingSensorDevice(std::unique_ptr<SensorDevice> device,
+    std::shared_ptr<SessionRecorder> recorder) {
+  if (!device || !recorder) {
+    return device;
+  }
+  return std::unique_ptr<SensorDevice>(new RecordingSensorDevice(std::move(device), recorder));
+}
@@ -0,0 +1,108 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "shader_permutations.h"
+
+#include <cstdio>
+
+#include <QElapsedTimer>
+#include <QFile>
+
+namespace {
+
+QByteArray ReadSource(const QString& fname) {
+  QFile file(fname);
+  if (!file.open(QIODevice::ReadOnly)) {
+    fprintf(stderr, "Failed to read shader %s\n", fname.toStdString().c_str());
+    return QByteArray();
+  }
+  return file.readAll();
+}
+
+} // namespace
+
+
+ShaderPermutations::ShaderPermutations(const QString& vertex_file, const QString& fragment_file,
+    const std::vector<const char*>& defines, const std::vector<const char*>& attributes,
+    ProgramBinaryCache* cache, QObject* parent): vertex_file_(vertex_file),
+    fragment_file_(fragment_file), defines_(defines), attributes_(attributes), cache_(cache),
+    parent_(parent) {
+}
+
+QOpenGLShaderProgram* ShaderPermutations::Get(unsigned features) {
+  auto it = programs_.find(features);
+  if (it != programs_.end()) {
+    return it->second;
+  }
+
+  if (vertex_source_.isEmpty()) {
+    vertex_source_ = ReadSource(vertex_file_);
+    fragment_source_ = ReadSource(fragment_file_);
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  QByteArray vertex = MakeSource(vertex_source_, features);
+  QByteArray fragment = MakeSource(fragment_source_, features);
+  // Ключ кэша: всё, что влияет на собранную программу
+  QByteArray key = vertex + '\0' + fragment;
+  for (auto attr: attributes_) {
+    key += '\0';
+    key += attr;
+  }
+
+  auto program = new QOpenGLShaderProgram(parent_);
+  bool cached = cache_ && cache_->Load(program, key);
+  if (!cached) {
+    program->addShaderFromSourceCode(QOpenGLShader::Vertex, vertex);
+    program->addShaderFromSourceCode(QOpenGLShader::Fragment, fragment);
+    for (size_t i = 0; i < attributes_.size(); ++i) {
+      program->bindAttributeLocation(attributes_[i], static_cast<int>(i));
+    }
+    if (cache_) {
+      cache_->PrepareLink(program);
+    }
+    if (program->link()) {
+      if (cache_) {
+        cache_->Save(program, key);
+      }
+    } else {
+      fprintf(stderr, "Failed to link shaders %s (features %x): %s\n",
+          vertex_file_.toStdString().c_str(), features, program->log().toStdString().c_str());
+    }
+  }
+  printf("Shaders %s (features %x): %s in %lld ms\n", vertex_file_.toStdString().c_str(),
+      features, cached ? "cache hit, loaded" : "cache miss, compiled",
+      static_cast<long long>(timer.elapsed()));
+  programs_[features] = program;
+  return program;
+}
+
+QByteArray ShaderPermutations::MakeSource(const QByteArray& source, unsigned features) const {
+  QByteArray defines;
+  for (size_t i = 0; i < defines_.size(); ++i) {
+    if (features & (1u << i)) {
+      defines += QByteArray("#define ") + defines_[i] + "\n";
+    }
+  }
+
+  // #version должна быть первой строкой шейдера
+  int pos = source.indexOf('\n') + 1;
+  QByteArray res = source;
+  return res.insert(pos, defines);
+}
@@ -1,39 +1,202 @@
 #include "tile.h"
 
+#include <algorithm>
+#include <cstring>
+
+// PSVR_TILE_SCALAR выключает SIMD, чтобы проверить скалярный вариант на x86
+#if defined(__AVX2__) && !defined(PSVR_TILE_SCALAR)
+#include <immintrin.h>
+#elif defined(__SSE2__) && !defined(PSVR_TILE_SCALAR)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const uint32_t kAlphaMask = 0xff000000;
+
+/*! Деление на 255 с округлением. Точно для value от 0 до 255 * 255 */
+inline uint32_t Div255(uint32_t value) {
+  value += 128;
+  return (value + (value >> 8)) >> 8;
+}
+
+inline uint32_t BlendPixel(uint32_t dst, uint32_t src) {
+  uint32_t inv = 255 - (src >> 24);
+  uint32_t res = 0;
+  for (int shift = 0; shift < 32; shift += 8) {
+    uint32_t d = (dst >> shift) & 0xff;
+    uint32_t s = (src >> shift) & 0xff;
+    uint32_t v = std::min<uint32_t>(s + Div255(d * inv), 255);
+    res |= v << shift;
+  }
+  return res;
+}
+
+#if defined(__AVX2__) && !defined(PSVR_TILE_SCALAR)
+
+/*! Смешивание 8-ми пикселей, развёрнутых в 16-битные каналы */
+inline __m256i BlendHalf(__m256i dst16, __m256i src16) {
+  const __m256i k255 = _mm256_set1_epi16(255);
+  const __m256i k128 = _mm256_set1_epi16(128);
+  __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(src16,
+      _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+  __m256i v = _mm256_add_epi16(_mm256_mullo_epi16(dst16,
+      _mm256_sub_epi16(k255, alpha)), k128);
+  return _mm256_srli_epi16(_mm256_add_epi16(v, _mm256_srli_epi16(v, 8)), 8);
+}
+
+size_t BlendRowSimd(uint32_t* dst, const uint32_t* src, size_t count) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i alpha_mask = _mm256_set1_epi32(kAlphaMask);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+    __m256i sa = _mm256_and_si256(s, alpha_mask);
+    if (_mm256_testz_si256(sa, sa)) {
+      continue; // Все пиксели прозрачные
+    }
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(sa, alpha_mask)) == -1) {
+      _mm256_storeu_si256((__m256i*)(dst + i), s); // Все пиксели непрозрачные
+      continue;
+    }
+    __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+    __m256i lo = BlendHalf(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(s, zero));
+    __m256i hi = BlendHalf(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(s, zero));
+    __m256i res = _mm256_adds_epu8(_mm256_packus_epi16(lo, hi), s);
+    _mm256_storeu_si256((__m256i*)(dst + i), res);
+  }
+  return i;
+}
+
+#elif defined(__SSE2__) && !defined(PSVR_TILE_SCALAR)
+
+/*! Смешивание 2-х пикселей, развёрнутых в 16-битные каналы */
+inline __m128i BlendHalf(__m128i dst16, __m128i src16) {
+  const __m128i k255 = _mm_set1_epi16(255);
+  const __m128i k128 = _mm_set1_epi16(128);
+  __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(src16,
+      _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+  __m128i v = _mm_add_epi16(_mm_mullo_epi16(dst16, _mm_sub_epi16(k255, alpha)), k128);
+  return _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)), 8);
+}
+
+size_t BlendRowSimd(uint32_t* dst, const uint32_t* src, size_t count) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i alpha_mask = _mm_set1_epi32(kAlphaMask);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+    __m128i sa = _mm_and_si128(s, alpha_mask);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(sa, zero)) == 0xffff) {
+      continue; // Все пиксели прозрачные
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi32(sa, alpha_mask)) == 0xffff) {
+      _mm_storeu_si128((__m128i*)(dst + i), s); // Все пиксели непрозрачные
+      continue;
+    }
+    __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+    __m128i lo = BlendHalf(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero));
+    __m128i hi = BlendHalf(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero));
+    __m128i res = _mm_adds_epu8(_mm_packus_epi16(lo, hi), s);
+    _mm_storeu_si128((__m128i*)(dst + i), res);
+  }
+  return i;
+}
+
+#else
+
+size_t BlendRowSimd(uint32_t*, const uint32_t*, size_t) {
+  return 0;
+}
+
+#endif
+
+} // namespace
+
+
+void MakeTileImage(TileImage& image, const std::vector<uint32_t>& rgba, size_t width) {
+  image.width = width;
+  image.height = width ? rgba.size() / width : 0;
+  image.pixels.assign(rgba.begin(), rgba.begin() + image.width * image.height);
+  PremultiplyPixels(image.pixels.data(), image.pixels.size());
+
+  image.row_kinds.resize(image.height);
+  for (size_t i = 0; i < image.height; ++i) {
+    const uint32_t* row = image.pixels.data() + i * width;
+    bool transparent = true;
+    bool opaque = true;
+    for (size_t j = 0; j < width; ++j) {
+      uint32_t alpha = row[j] & kAlphaMask;
+      transparent = transparent && alpha == 0;
+      opaque = opaque && alpha == kAlphaMask;
+    }
+    image.row_kinds[i] = transparent ? kTransparentRow :
+        (opaque ? kOpaqueRow : kMixedRow);
+  }
+}
+
+void PremultiplyPixels(uint32_t* pixels, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t p = pixels[i];
+    uint32_t alpha = p >> 24;
+    uint32_t res = p & kAlphaMask;
+    for (int shift = 0; shift < 24; shift += 8) {
+      res |= Div255(((p >> shift) & 0xff) * alpha) << shift;
+    }
+    pixels[i] = res;
+  }
+}
+
+void BlendRow(uint32_t* dst, const uint32_t* src, size_t count) {
+  for (size_t i = BlendRowSimd(dst, src, count); i < count; ++i) {
+    uint32_t alpha = src[i] & kAlphaMask;
+    if (alpha == kAlphaMask) {
+      dst[i] = src[i];
+    } else if (alpha != 0) {
+      dst[i] = BlendPixel(dst[i], src[i]);
+    }
+  }
+}
+
 void AddTile(std::vector<uint32_t>& canvas, size_t canvas_width,
-    const std::vector<uint32_t>& tile, size_t tile_width,
-    size_t xpos, size_t ypos) {
-  if (canvas_width == 0 || tile_width == 0) { return; }
+    const TileImage& tile, size_t xpos, size_t ypos, const TileRect& clip) {
+  if (canvas_width == 0 || tile.width == 0) { return; }
   if ((canvas.size() % canvas_width) != 0) { return; }
-  if ((tile.size() % tile_width) != 0) { return; }
-  if (xpos >= canvas_width) { return; }
-
-  uint32_t* canvas_end = canvas.data() + canvas.size();
-  const uint32_t* tile_end = tile.data() + tile.size();
-  size_t row_width = std::min(canvas_width - xpos, tile_width);
-
-  uint32_t* dst = canvas.data() + ypos * canvas_width + xpos;
-  const uint32_t* src = tile.data();
-  while (dst < canvas_end && src < tile_end) {
-    for (size_t j = 0; j < row_width; ++j) {
-      struct pixel {
-        uint8_t red;
-        uint8_t green;
-        uint8_t blue;
-        uint8_t alpha;
-      };
-
-      auto pres = *(pixel*)(dst + j);
-      auto pmsk = *(pixel*)(src + j);
-      float sol = pmsk.alpha / 255.0f;
-      float tra = 1.0f - sol;
-      pres.red = pres.red * tra + pmsk.red * sol;
-      pres.green = pres.green * tra + pmsk.green * sol;
-      pres.blue = pres.blue * tra + pmsk.blue * sol;
-      pres.alpha = 255 - (uint8_t)((255 - pres.alpha) * tra);
-      *(pixel*)(dst + j) = pres;
+
+  TileRect canvas_rect = {0, 0, canvas_width, canvas.size() / canvas_width};
+  TileRect tile_rect = {xpos, ypos, tile.width, tile.height};
+  TileRect area = IntersectRects(IntersectRects(canvas_rect, clip), tile_rect);
+  if (area.width == 0 || area.height == 0) { return; }
+
+  uint32_t* dst = canvas.data() + area.y * canvas_width + area.x;
+  size_t src_row = area.y - ypos;
+  const uint32_t* src = tile.pixels.data() + src_row * tile.width + (area.x - xpos);
+  for (size_t i = 0; i < area.height; ++i) {
+    switch (tile.row_kinds[src_row + i]) {
+      case kTransparentRow:
+        break;
+      case kOpaqueRow:
+        std::memcpy(dst, src, area.width * sizeof(uint32_t));
+        break;
+      default:
+        BlendRow(dst, src, area.width);
+        break;
     }
     dst += canvas_width;
-    src += tile_width;
+    src += tile.width;
+  }
+}
+
+TileRect IntersectRects(const TileRect& r1, const TileRect& r2) {
+  size_t left = std::max(r1.x, r2.x);
+  size_t top = std::max(r1.y, r2.y);
+  size_t right = std::min(r1.x + r1.width, r2.x + r2.width);
+  size_t bottom = std::min(r1.y + r1.height, r2.y + r2.height);
+  if (right <= left || bottom <= top) {
+    TileRect empty = {left, top, 0, 0};
+    return empty;
   }
+
+  TileRect res = {left, top, right - left, bottom - top};
+  return res;
 }
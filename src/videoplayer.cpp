@@ -66,6 +66,7 @@ VideoPlayer::VideoPlayer(QObject *parent) : QObject(parent)
 	media_player = 0;
 	event_manager = 0;
   need_update_screen_ = false;
+  dropped_frames_ = 0;
 
 	const char *vlc_argv[] =
 		{
@@ -75,6 +76,9 @@ VideoPlayer::VideoPlayer(QObject *parent) : QObject(parent)
 
 	libvlc = libvlc_new(2, vlc_argv); // vlc_argv);
 
+	connect(&frame_notifier_, SIGNAL(Notified()), this, SIGNAL(DisplayVideoFrame()));
+	connect(&position_notifier_, SIGNAL(Notified()), this, SLOT(DeliverPosition()));
+
 	if(!libvlc)
 	{
 		fprintf(stderr, "Failed to initialize LibVLC\n");
@@ -192,6 +196,13 @@ bool VideoPlayer::IsPlaying()
 	return libvlc_media_player_is_playing(media_player) != 0;
 }
 
+int64_t VideoPlayer::GetTime()
+{
+  if(!media_player)
+    return -1;
+  return libvlc_media_player_get_time(media_player);
+}
+
 void *VideoPlayer::VLC_Lock(void **p_pixels)
 {
   std::lock_guard<std::mutex> l(video_data_lock_);
@@ -203,6 +214,10 @@ void *VideoPlayer::VLC_Lock(void **p_pixels)
 void VideoPlayer::VLC_Unlock(void *id, void *const *p_pixels)
 {
   std::lock_guard<std::mutex> l(video_data_lock_);
+  if (need_update_screen_) {
+    // Предыдущий кадр так и не был выведен
+    ++dropped_frames_;
+  }
   last_vlc_frame_ = vlc_locked_data_;
   vlc_locked_data_.reset();
   need_update_screen_ = true;
@@ -210,7 +225,7 @@ void VideoPlayer::VLC_Unlock(void *id, void *const *p_pixels)
 
 void VideoPlayer::VLC_Display(void *id)
 {
-	emit DisplayVideoFrame();
+	frame_notifier_.Notify();
 	//printf("display\n");
 }
 
@@ -232,7 +247,7 @@ void VideoPlayer::VLC_Event(const struct libvlc_event_t *event)
 	switch(event->type)
 	{
 		case libvlc_MediaPlayerPositionChanged:
-			emit PositionChanged(event->u.media_player_position_changed.new_position);
+			position_notifier_.Set(event->u.media_player_position_changed.new_position);
 			break;
 		case libvlc_MediaPlayerPlaying:
 			emit Playing();
@@ -301,3 +316,8 @@ VideoDataInfoPtr VideoDataCache::GetAvailableData() {
   }
   return VideoDataInfoPtr();
 }
+
+void VideoPlayer::DeliverPosition()
+{
+	emit PositionChanged(position_notifier_.Get());
+}
@@ -0,0 +1,172 @@
+/*
+ * Created by Evgeny Kislov <dev@evgenykislov.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Генератор атласа картинок меню. Запускается при сборке:
+//   sprite_atlas_gen <out_dir> <sprite_dir> <id>=<file>:<width> ...
+// Картинки (сырые пиксели rgba) собираются в один атлас с предумноженной
+// прозрачностью. В out_dir создаются заголовки:
+//   sprite_atlas.h - идентификаторы картинок, размер атласа и области картинок;
+//   sprite_atlas_data.h - пиксели атласа (подключается в одном месте).
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "overlay.h"
+#include "tile.h"
+
+namespace {
+
+const size_t kPixelsPerLine = 8;
+
+struct SpriteSource {
+  std::string id; //!< Имя идентификатора картинки в SpriteId
+  std::string fname;
+  size_t width;
+  TileImage image;
+};
+
+bool ParseSprite(const std::string& arg, SpriteSource& sprite) {
+  auto eq = arg.find('=');
+  auto colon = arg.rfind(':');
+  if (eq == std::string::npos || colon == std::string::npos || colon < eq) {
+    return false;
+  }
+  sprite.id = arg.substr(0, eq);
+  sprite.fname = arg.substr(eq + 1, colon - eq - 1);
+  try {
+    sprite.width = std::stoul(arg.substr(colon + 1));
+  } catch (std::exception&) {
+    return false;
+  }
+  return !sprite.id.empty() && !sprite.fname.empty() && sprite.width > 0;
+}
+
+bool LoadSprite(const std::string& dir, SpriteSource& sprite) {
+  std::ifstream f(dir + "/" + sprite.fname, std::ios::binary);
+  if (!f) {
+    fprintf(stderr, "Can't open sprite %s\n", sprite.fname.c_str());
+    return false;
+  }
+  std::vector<char> raw((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+  size_t row_size = sprite.width * sizeof(uint32_t);
+  if (raw.empty() || raw.size() % row_size != 0) {
+    fprintf(stderr, "Sprite %s size %zu doesn't match width %zu\n",
+        sprite.fname.c_str(), raw.size(), sprite.width);
+    return false;
+  }
+  std::vector<uint32_t> rgba(raw.size() / sizeof(uint32_t));
+  std::copy(raw.begin(), raw.end(), (char*)rgba.data());
+  MakeTileImage(sprite.image, rgba, sprite.width);
+  return true;
+}
+
+bool WriteRects(const std::string& fname, const std::vector<SpriteSource>& sprites,
+    size_t width, size_t height, const std::vector<TileRect>& rects) {
+  FILE* f = fopen(fname.c_str(), "w");
+  if (!f) {
+    fprintf(stderr, "Can't create %s\n", fname.c_str());
+    return false;
+  }
+
+  fprintf(f, "// Generated by sprite_atlas_gen from sprite/*.data. Do not edit\n\n");
+  fprintf(f, "#ifndef SPRITE_ATLAS_PSVR_PLAYER_GENERATED\n");
+  fprintf(f, "#define SPRITE_ATLAS_PSVR_PLAYER_GENERATED\n\n");
+  fprintf(f, "#include <cstddef>\n\n#include \"tile.h\"\n\n");
+  fprintf(f, "namespace sprite_atlas {\n\n");
+  fprintf(f, "enum SpriteId {\n");
+  for (auto& s: sprites) {
+    fprintf(f, "  %s,\n", s.id.c_str());
+  }
+  fprintf(f, "  kSpriteCount\n};\n\n");
+  fprintf(f, "constexpr size_t kWidth = %zu;\n", width);
+  fprintf(f, "constexpr size_t kHeight = %zu;\n\n", height);
+  fprintf(f, "/*! Область каждой картинки в атласе (в порядке SpriteId) */\n");
+  fprintf(f, "constexpr TileRect kRects[kSpriteCount] = {\n");
+  for (size_t i = 0; i < sprites.size(); ++i) {
+    fprintf(f, "  {%zu, %zu, %zu, %zu}, // %s\n", rects[i].x, rects[i].y,
+        rects[i].width, rects[i].height, sprites[i].id.c_str());
+  }
+  fprintf(f, "};\n\n} // namespace sprite_atlas\n\n#endif\n");
+  return fclose(f) == 0;
+}
+
+bool WritePixels(const std::string& fname, const std::vector<uint32_t>& pixels) {
+  FILE* f = fopen(fname.c_str(), "w");
+  if (!f) {
+    fprintf(stderr, "Can't create %s\n", fname.c_str());
+    return false;
+  }
+
+  fprintf(f, "// Generated by sprite_atlas_gen from sprite/*.data. Do not edit\n\n");
+  fprintf(f, "#ifndef SPRITE_ATLAS_DATA_PSVR_PLAYER_GENERATED\n");
+  fprintf(f, "#define SPRITE_ATLAS_DATA_PSVR_PLAYER_GENERATED\n\n");
+  fprintf(f, "#include <cstdint>\n\n#include \"sprite_atlas.h\"\n\n");
+  fprintf(f, "namespace sprite_atlas {\n\n");
+  fprintf(f, "/*! Пиксели атласа rgba с предумноженной прозрачностью */\n");
+  fprintf(f, "constexpr uint32_t kPixels[kWidth * kHeight] = {\n");
+  for (size_t i = 0; i < pixels.size(); ++i) {
+    fprintf(f, (i % kPixelsPerLine) == 0 ? "  0x%08x," : " 0x%08x,", pixels[i]);
+    if ((i % kPixelsPerLine) == kPixelsPerLine - 1 || i + 1 == pixels.size()) {
+      fprintf(f, "\n");
+    }
+  }
+  fprintf(f, "};\n\n} // namespace sprite_atlas\n\n#endif\n");
+  return fclose(f) == 0;
+}
+
+} // namespace
+
+
+int main(int argc, char** argv) {
+  if (argc < 4) {
+    fprintf(stderr, "Usage: sprite_atlas_gen <out_dir> <sprite_dir> <id>=<file>:<width> ...\n");
+    return 1;
+  }
+
+  std::string out_dir = argv[1];
+  std::string sprite_dir = argv[2];
+  std::vector<SpriteSource> sprites(argc - 3);
+  for (size_t i = 0; i < sprites.size(); ++i) {
+    if (!ParseSprite(argv[i + 3], sprites[i])) {
+      fprintf(stderr, "Wrong sprite description %s\n", argv[i + 3]);
+      return 1;
+    }
+    if (!LoadSprite(sprite_dir, sprites[i])) {
+      return 1;
+    }
+  }
+
+  std::vector<const TileImage*> images;
+  for (auto& s: sprites) {
+    images.push_back(&s.image);
+  }
+  std::vector<uint32_t> pixels;
+  size_t width = 0;
+  size_t height = 0;
+  std::vector<TileRect> rects;
+  BuildOverlayAtlas(pixels, width, height, images, rects);
+
+  if (!WriteRects(out_dir + "/sprite_atlas.h", sprites, width, height, rects) ||
+      !WritePixels(out_dir + "/sprite_atlas_data.h", pixels)) {
+    return 1;
+  }
+  return 0;
+}